@@ -0,0 +1,439 @@
+/*
+	bench/bench.c
+
+	内核堆的主机端基准测试：将 core/memory.c 与 core/slab.c 编译为 Linux 程序，
+	回放分配轨迹并报告吞吐量、延迟分位数与碎片情况。
+
+	轨迹为文本，每行一个操作，格式与内核启用 MEMORY_TRACE 后经串口输出的一致：
+		MEMTRACE: a <size> <ptr>			kmalloc
+		MEMTRACE: A <size> <align> <ptr>	kmalloc_aligned
+		MEMTRACE: r <old> <size> <new>		krealloc
+		MEMTRACE: f <ptr>					kfree
+	不含 `MEMTRACE: ` 的行被忽略，因此可以直接回放完整的串口日志。
+*/
+
+#define _GNU_SOURCE
+
+/* 主机头文件须先于内核头文件包含，以免其中的声明被 io.h 替身中的同名宏改写 */
+#include <search.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ClassiX/memory.h>
+#include <ClassiX/slab.h>
+#include <ClassiX/typedef.h>
+
+#define TRACE_TAG							"MEMTRACE: "
+
+#define DEFAULT_POOL_MIB					(64)		/* 默认内存池大小 */
+#define DEFAULT_REPEAT						(5)			/* 默认吞吐量测试轮数 */
+#define DEFAULT_SEED						(1)			/* 默认随机种子 */
+#define DEFAULT_SYNTH_OPS					(200000)	/* 合成负载的默认操作数 */
+#define SYNTH_SLOTS							(4096)		/* 合成负载的最大存活对象数 */
+
+typedef enum {
+	OP_ALLOC,			/* kmalloc */
+	OP_ALLOC_ALIGNED,	/* kmalloc_aligned */
+	OP_REALLOC,			/* krealloc */
+	OP_FREE				/* kfree */
+} op_type_t;
+
+/* 回放操作；轨迹中的指针在解析时被换成稠密的槽位号 */
+typedef struct {
+	op_type_t type;
+	uint32_t slot;
+	uint32_t size;
+	uint32_t align;
+} op_t;
+
+typedef struct {
+	const char *name;
+	op_t *ops;
+	size_t count;
+	size_t capacity;
+	uint32_t slots;		/* 槽位总数 */
+} workload_t;
+
+/* 轨迹指针到槽位的映射 */
+typedef struct {
+	uint32_t id;
+	uint32_t slot;
+} id_entry_t;
+
+typedef struct {
+	uint64_t best_ns;			/* 最快一轮的耗时 */
+	uint32_t *alloc_lat;		/* 分配类操作的延迟 */
+	size_t alloc_count;
+	uint32_t *free_lat;			/* 释放操作的延迟 */
+	size_t free_count;
+	size_t peak_requested;		/* 存活请求字节数的峰值 */
+	size_t peak_in_use;			/* 此时内存池的已分配字节数 */
+	uint32_t failures;			/* 回放时失败的分配 */
+	MEMORY_INFO end;			/* 延迟轮结束、存活对象尚未释放时的快照 */
+} result_t;
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void workload_push(workload_t *w, op_type_t type, uint32_t slot, uint32_t size, uint32_t align)
+{
+	if (w->count == w->capacity) {
+		w->capacity = w->capacity ? w->capacity * 2 : 1024;
+		w->ops = realloc(w->ops, w->capacity * sizeof(op_t));
+		if (!w->ops) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	w->ops[w->count++] = (op_t) { type, slot, size, align };
+}
+
+static int id_compare(const void *a, const void *b)
+{
+	uint32_t x = ((const id_entry_t *) a)->id, y = ((const id_entry_t *) b)->id;
+	return x < y ? -1 : x > y;
+}
+
+/* 查找轨迹指针对应的槽位，不存在时返回 NULL */
+static id_entry_t *id_find(void **root, uint32_t id)
+{
+	id_entry_t key = { id, 0 };
+	id_entry_t **found = tfind(&key, root, id_compare);
+	return found ? *found : NULL;
+}
+
+/* 绑定轨迹指针与槽位，覆盖已有的绑定 */
+static void id_bind(void **root, uint32_t id, uint32_t slot)
+{
+	id_entry_t *entry = id_find(root, id);
+	if (entry) {
+		entry->slot = slot;
+		return;
+	}
+
+	entry = malloc(sizeof(id_entry_t));
+	*entry = (id_entry_t) { id, slot };
+	tsearch(entry, root, id_compare);
+}
+
+static void id_unbind(void **root, id_entry_t *entry)
+{
+	tdelete(entry, root, id_compare);
+	free(entry);
+}
+
+/*
+	@brief 解析分配轨迹。
+	@param w 输出的负载
+	@param file 轨迹文件
+	@note 失败的分配、以及释放捕获开始前分配的内存等无法对应的操作被丢弃。
+*/
+static void workload_parse(workload_t *w, FILE *file)
+{
+	void *root = NULL;
+	char line[256];
+	unsigned long a, b, c;
+
+	while (fgets(line, sizeof(line), file)) {
+		const char *p = strstr(line, TRACE_TAG);
+		if (!p) continue;
+		p += strlen(TRACE_TAG);
+
+		id_entry_t *entry;
+		switch (*p) {
+			case 'a':
+				if (sscanf(p + 1, "%lu %lx", &a, &b) != 2 || !b) break;
+				id_bind(&root, (uint32_t) b, w->slots);
+				workload_push(w, OP_ALLOC, w->slots++, (uint32_t) a, 0);
+				break;
+			case 'A':
+				if (sscanf(p + 1, "%lu %lu %lx", &a, &b, &c) != 3 || !c) break;
+				id_bind(&root, (uint32_t) c, w->slots);
+				workload_push(w, OP_ALLOC_ALIGNED, w->slots++, (uint32_t) a, (uint32_t) b);
+				break;
+			case 'r':
+				if (sscanf(p + 1, "%lx %lu %lx", &a, &b, &c) != 3 || !c) break;
+				entry = id_find(&root, (uint32_t) a);
+				if (!entry) {
+					/* 原内存块分配于捕获开始前，按新分配处理 */
+					id_bind(&root, (uint32_t) c, w->slots);
+					workload_push(w, OP_ALLOC, w->slots++, (uint32_t) b, 0);
+					break;
+				}
+				uint32_t slot = entry->slot;
+				workload_push(w, OP_REALLOC, slot, (uint32_t) b, 0);
+				if (a != c) {
+					id_unbind(&root, entry);
+					id_bind(&root, (uint32_t) c, slot);
+				}
+				break;
+			case 'f':
+				if (sscanf(p + 1, "%lx", &a) != 1) break;
+				entry = id_find(&root, (uint32_t) a);
+				if (!entry) break;
+				workload_push(w, OP_FREE, entry->slot, 0, 0);
+				id_unbind(&root, entry);
+				break;
+		}
+	}
+
+	tdestroy(root, free);
+}
+
+static inline uint32_t xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/* 随机大小：多数为 slab 服务的小对象，少数为内存池服务的缓冲区 */
+static uint32_t synth_size(uint32_t *rng)
+{
+	uint32_t r = xorshift32(rng) % 100;
+	if (r < 60) return 16 + xorshift32(rng) % (512 - 16 + 1);
+	if (r < 90) return 513 + xorshift32(rng) % (4096 - 513 + 1);
+	if (r < 99) return 4097 + xorshift32(rng) % (32768 - 4097 + 1);
+	return 32769 + xorshift32(rng) % (131072 - 32769 + 1);
+}
+
+/*
+	@brief 生成合成负载：在固定数量的槽位上随机分配、调整与释放。
+	@param w 输出的负载
+	@param count 操作数
+	@param seed 随机种子
+*/
+static void workload_synthetic(workload_t *w, size_t count, uint32_t seed)
+{
+	static bool live[SYNTH_SLOTS];
+	uint32_t rng = seed ? seed : 1;
+
+	w->slots = SYNTH_SLOTS;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t slot = xorshift32(&rng) % SYNTH_SLOTS;
+		uint32_t r = xorshift32(&rng) % 100;
+
+		if (!live[slot]) {
+			if (r < 5)
+				workload_push(w, OP_ALLOC_ALIGNED, slot, synth_size(&rng), 64u << (xorshift32(&rng) % 7));
+			else
+				workload_push(w, OP_ALLOC, slot, synth_size(&rng), 0);
+			live[slot] = true;
+		} else if (r < 15) {
+			workload_push(w, OP_REALLOC, slot, synth_size(&rng), 0);
+		} else {
+			workload_push(w, OP_FREE, slot, 0, 0);
+			live[slot] = false;
+		}
+	}
+}
+
+static bool irq_frees = false;		/* 是否在关中断状态下回放释放，模拟中断处理程序与定时器回调 */
+
+/* 执行单个操作，返回是否失败 */
+static inline bool op_run(const op_t *op, void **ptrs)
+{
+	void *ptr;
+	switch (op->type) {
+		case OP_ALLOC:
+			return !(ptrs[op->slot] = kmalloc(op->size));
+		case OP_ALLOC_ALIGNED:
+			return !(ptrs[op->slot] = kmalloc_aligned(op->size, op->align));
+		case OP_REALLOC:
+			if (!ptrs[op->slot]) return false;
+			ptr = krealloc(ptrs[op->slot], op->size);
+			if (!ptr) return true;
+			ptrs[op->slot] = ptr;
+			return false;
+		case OP_FREE:
+			if (ptrs[op->slot]) {
+				if (irq_frees) cli();
+				kfree(ptrs[op->slot]);
+				if (irq_frees) sti();
+			}
+			ptrs[op->slot] = NULL;
+			return false;
+	}
+	return false;
+}
+
+/* 释放回放结束时仍存活的对象，并排空延迟释放环 */
+static void release_all(const workload_t *w, void **ptrs)
+{
+	for (uint32_t i = 0; i < w->slots; i++)
+		if (ptrs[i]) {
+			kfree(ptrs[i]);
+			ptrs[i] = NULL;
+		}
+	kfree_drain();
+}
+
+static int lat_compare(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t count, uint32_t pct)
+{
+	if (!count) return 0;
+	size_t i = (count * pct + 99) / 100;
+	return sorted[i ? i - 1 : 0];
+}
+
+/*
+	@brief 回放负载。
+	@param w 负载
+	@param repeat 吞吐量测试轮数
+	@param r 输出结果
+	@note 先进行一轮逐操作计时的回放以测延迟与碎片，再进行不计单次延迟的若干轮以测吞吐量。
+*/
+static void replay(const workload_t *w, uint32_t repeat, result_t *r)
+{
+	void **ptrs = calloc(w->slots ? w->slots : 1, sizeof(void *));
+	uint32_t *sizes = calloc(w->slots ? w->slots : 1, sizeof(uint32_t));
+	memset(r, 0, sizeof(*r));
+
+	/* 延迟轮：从刚初始化的内存池开始，扣除 slab 位图等分配器自身的占用 */
+	r->alloc_lat = malloc((w->count + 1) * sizeof(uint32_t));
+	r->free_lat = malloc((w->count + 1) * sizeof(uint32_t));
+	size_t base_in_use = g_mp.stats.bytes_in_use;
+	size_t requested = 0;
+
+	for (size_t i = 0; i < w->count; i++) {
+		const op_t *op = &w->ops[i];
+		uint32_t old_size = ptrs[op->slot] ? sizes[op->slot] : 0;
+
+		uint64_t start = now_ns();
+		bool failed = op_run(op, ptrs);
+		uint32_t ns = (uint32_t) (now_ns() - start);
+
+		if (op->type == OP_FREE)
+			r->free_lat[r->free_count++] = ns;
+		else
+			r->alloc_lat[r->alloc_count++] = ns;
+		if (failed) r->failures++;
+
+		/* 统计存活的请求字节数 */
+		uint32_t new_size = ptrs[op->slot] ? (op->type == OP_FREE ? 0 : failed ? old_size : op->size) : 0;
+		requested = requested - old_size + new_size;
+		sizes[op->slot] = new_size;
+		if (requested > r->peak_requested) {
+			r->peak_requested = requested;
+			r->peak_in_use = g_mp.stats.bytes_in_use - base_in_use;
+		}
+	}
+
+	memory_get_info(&g_mp, &r->end);
+	release_all(w, ptrs);
+
+	/* 吞吐量轮 */
+	r->best_ns = UINT64_MAX;
+	for (uint32_t pass = 0; pass < repeat; pass++) {
+		uint64_t start = now_ns();
+		for (size_t i = 0; i < w->count; i++)
+			op_run(&w->ops[i], ptrs);
+		uint64_t elapsed = now_ns() - start;
+		if (elapsed < r->best_ns)
+			r->best_ns = elapsed;
+		release_all(w, ptrs);
+	}
+
+	qsort(r->alloc_lat, r->alloc_count, sizeof(uint32_t), lat_compare);
+	qsort(r->free_lat, r->free_count, sizeof(uint32_t), lat_compare);
+	free(ptrs);
+	free(sizes);
+}
+
+static void report(const workload_t *w, uint32_t repeat, const result_t *r)
+{
+	printf("workload    %s, %zu ops, %u slots\n", w->name, w->count, w->slots);
+	printf("throughput  %.2f Mops/s (best of %u passes, %.3f ms)\n",
+		r->best_ns ? w->count * 1e3 / r->best_ns : 0.0, repeat, r->best_ns / 1e6);
+	printf("alloc       p50 %u ns, p99 %u ns, max %u ns (%zu ops)\n",
+		percentile(r->alloc_lat, r->alloc_count, 50), percentile(r->alloc_lat, r->alloc_count, 99),
+		r->alloc_count ? r->alloc_lat[r->alloc_count - 1] : 0, r->alloc_count);
+	printf("free        p50 %u ns, p99 %u ns, max %u ns (%zu ops)\n",
+		percentile(r->free_lat, r->free_count, 50), percentile(r->free_lat, r->free_count, 99),
+		r->free_count ? r->free_lat[r->free_count - 1] : 0, r->free_count);
+	printf("peak        %zu bytes requested, %zu bytes in pool, utilisation %.1f%%\n",
+		r->peak_requested, r->peak_in_use,
+		r->peak_in_use ? 100.0 * r->peak_requested / r->peak_in_use : 100.0);
+	printf("end         %u free blocks, largest %zu of %zu free bytes, fragmentation %.1f%%\n",
+		r->end.free_blocks, r->end.largest_free, r->end.free_bytes,
+		r->end.free_bytes ? 100.0 * (1.0 - (double) r->end.largest_free / r->end.free_bytes) : 0.0);
+	printf("failures    %u failed allocations\n", r->failures);
+	printf("irq-off     %llu cycles holding pool lock, %llu cycles in kfree with irqs off (%u deferred, %u overflowed)\n",
+		(unsigned long long) r->end.stats.irqoff_max, (unsigned long long) r->end.stats.irq_free_max,
+		r->end.stats.deferred_frees, r->end.stats.defer_overflows);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-i] [-m pool_mib] [-r repeat] [-n ops] [-s seed] [trace]\n"
+		"  -i      replay frees with interrupts disabled, as from an ISR or timer callback\n"
+		"  trace   allocation trace or serial log with MEMTRACE lines, `-` for stdin;\n"
+		"          without it a synthetic workload is generated\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	size_t pool_mib = DEFAULT_POOL_MIB;
+	uint32_t repeat = DEFAULT_REPEAT;
+	size_t synth_ops = DEFAULT_SYNTH_OPS;
+	uint32_t seed = DEFAULT_SEED;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "im:r:n:s:h")) != -1) {
+		switch (opt) {
+			case 'i': irq_frees = true; break;
+			case 'm': pool_mib = strtoul(optarg, NULL, 0); break;
+			case 'r': repeat = strtoul(optarg, NULL, 0); break;
+			case 'n': synth_ops = strtoul(optarg, NULL, 0); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (argc - optind > 1 || !pool_mib || !repeat) usage(argv[0]);
+
+	workload_t w = { 0 };
+	if (optind < argc) {
+		w.name = argv[optind];
+		FILE *file = strcmp(w.name, "-") ? fopen(w.name, "r") : stdin;
+		if (!file) {
+			perror(w.name);
+			return 1;
+		}
+		workload_parse(&w, file);
+		if (file != stdin) fclose(file);
+	} else {
+		w.name = "synthetic";
+		workload_synthetic(&w, synth_ops, seed);
+	}
+
+	size_t pool_size = pool_mib << 20;
+	void *pool = aligned_alloc(SLAB_SIZE, pool_size);
+	if (!pool) {
+		perror("aligned_alloc");
+		return 1;
+	}
+	memset(pool, 0, pool_size);		/* 预先触发缺页，避免计入首轮延迟 */
+	memory_init(&g_mp, pool, pool_size);
+	kmem_init();
+
+	result_t r;
+	replay(&w, repeat, &r);
+	report(&w, repeat, &r);
+	return 0;
+}
@@ -0,0 +1,314 @@
+/*
+	bench/compose_bench.c
+
+	拖动窗口时输入到画面的延迟：将 ui/layer.c 编译为 Linux 程序，在主机内存中的帧缓冲上执行真实的 layer_move，
+	以其耗时推进模拟的时间，比较两种处理方式下每个鼠标数据包自到达至画面反映其位置的延迟：
+	改动前由输入任务在取完积压的数据后自行移动图层，改动后将移动交给合成任务，输入任务可抢占合成任务。
+	合成任务的排队与合并按 ui/compositor.c 的逻辑模拟，任务切换与唤醒的开销不计。
+*/
+
+/* 主机头文件须先于内核头文件包含，以免其中的声明被 io.h 替身中的同名宏改写 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* POSIX 的 timer_create 与 timer_delete 与内核接口同名，包含 time.h 时改名回避 */
+#define timer_create						posix_timer_create
+#define timer_delete						posix_timer_delete
+#include <time.h>
+#undef timer_create
+#undef timer_delete
+
+#include <ClassiX/framebuf.h>
+#include <ClassiX/layer.h>
+#include <ClassiX/memory.h>
+#include <ClassiX/slab.h>
+#include <ClassiX/sync.h>
+#include <ClassiX/typedef.h>
+
+#define SCREEN_WIDTH						(1280)		/* 与 boot.asm 请求的默认视频模式一致 */
+#define SCREEN_HEIGHT						(800)
+#define CURSOR_SIZE							(32)		/* 光标图层的边长 */
+#define DEFAULT_PACKETS						(2000)		/* 默认的鼠标数据包数量 */
+#define DEFAULT_INTERVAL_US					(10000)		/* 默认的数据包间隔，PS/2 鼠标默认每秒 100 个 */
+#define DEFAULT_DECODE_NS					(2000)		/* 默认解码并命中测试一个数据包的耗时 */
+#define DEFAULT_WIDTH						(480)		/* 默认拖动的窗口大小，与终端窗口一致 */
+#define DEFAULT_HEIGHT						(300)
+#define STEP_X								(6)			/* 每个数据包的位移 */
+#define STEP_Y								(4)
+#define POOL_MIB							(64)		/* 内存池大小 */
+#define NEVER								(UINT64_MAX)
+
+/* 帧缓冲位于主机内存，颜色格式为标准 ARGB，layer.c 直接写入而不调用 set_pixel */
+FRAMEBUFFER g_fb = { .width = SCREEN_WIDTH, .height = SCREEN_HEIGHT, .bpp = 32, .argb_format = true };
+
+void set_pixel(uint16_t x, uint16_t y, COLOR color) {}
+
+/* 只有一个执行流，图层管理器的锁无需等待 */
+void mutex_lock(MUTEX *mutex) {}
+void mutex_unlock(MUTEX *mutex) {}
+
+/* 两个被移动的图层 */
+enum { TARGET_CURSOR, TARGET_WINDOW, TARGET_COUNT };
+
+static LAYER *layers[TARGET_COUNT];
+static uint32_t packets;				/* 数据包数量 */
+static uint64_t interval;				/* 数据包间隔（纳秒） */
+static uint64_t decode_ns;				/* 解码一个数据包的耗时 */
+
+static uint64_t *photon[TARGET_COUNT];	/* 各数据包的位置首次出现在画面上的时刻 */
+static uint32_t shown[TARGET_COUNT];	/* 已出现在画面上的数据包数量 */
+static uint64_t moves;					/* layer_move 的调用次数 */
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* 第 k 个数据包到达的时刻 */
+static inline uint64_t arrival(uint32_t k)
+{
+	return k < packets ? (uint64_t) (k + 1) * interval : NEVER;
+}
+
+/* 第 k 个数据包对应的位置，在屏幕内往返 */
+static int32_t bounce(int64_t pos, int32_t range)
+{
+	if (range <= 0)
+		return 0;
+	pos %= 2 * range;
+	return (int32_t) (pos < range ? pos : 2 * range - pos);
+}
+
+static void position(uint32_t target, uint32_t k, int32_t *x, int32_t *y)
+{
+	const LAYER *layer = layers[target];
+	*x = bounce((int64_t) (k + 1) * STEP_X, SCREEN_WIDTH - layer->width);
+	*y = bounce((int64_t) (k + 1) * STEP_Y, SCREEN_HEIGHT - layer->height);
+}
+
+/* 将图层移动到第 k 个数据包的位置，返回实际耗时 */
+static uint64_t timed_move(uint32_t target, uint32_t k)
+{
+	int32_t x, y;
+	position(target, k, &x, &y);
+	uint64_t start = now_ns();
+	layer_move(layers[target], x, y);
+	moves++;
+	return now_ns() - start;
+}
+
+/* 在时刻 t 完成的移动反映了第 k 个及之前的数据包 */
+static void show(uint32_t target, uint32_t k, uint64_t t)
+{
+	while (shown[target] <= k)
+		photon[target][shown[target]++] = t;
+}
+
+/* 全部数据包都已反映在画面上 */
+static inline bool done(void)
+{
+	return shown[TARGET_CURSOR] == packets && shown[TARGET_WINDOW] == packets;
+}
+
+/*
+	改动前的主循环：取完积压的数据包后，光标有更新则移动光标，否则移动拖动中的窗口；
+	窗口的更新标志从不清除，拖动期间没有输入时反复移动窗口。移动期间到达的数据包须等待其完成。
+*/
+static void run_before(void)
+{
+	uint64_t t = 0;
+	uint32_t decoded = 0;		/* 已解码的数据包数量 */
+	bool cursor_updated = false, window_updated = false;
+
+	while (!done()) {
+		if (arrival(decoded) <= t) {
+			t += decode_ns;
+			decoded++;
+			cursor_updated = window_updated = true;
+		} else if (cursor_updated) {
+			t += timed_move(TARGET_CURSOR, decoded - 1);
+			show(TARGET_CURSOR, decoded - 1, t);
+			cursor_updated = false;
+		} else if (window_updated) {
+			t += timed_move(TARGET_WINDOW, decoded - 1);
+			show(TARGET_WINDOW, decoded - 1, t);
+		} else {
+			t = arrival(decoded);
+		}
+	}
+}
+
+/* 合成任务的一帧中待执行的移动 */
+typedef struct {
+	uint32_t target;
+	uint32_t packet;		/* 反映到的数据包 */
+} MOVE;
+
+/*
+	改动后：输入任务取完积压的数据包后提交光标与窗口的最终位置，合成任务取出全部请求，按图层合并后各移动一次。
+	数据包到达时输入任务立即抢占合成任务；被抢占的移动在输入任务让出处理器后继续，期间提交的请求留待下一帧。
+*/
+static void run_after(void)
+{
+	uint64_t t = 0;
+	uint32_t decoded = 0;
+	bool cursor_updated = false, window_updated = false;
+
+	MOVE queue[2 * TARGET_COUNT];	/* 已提交、尚未取出的请求 */
+	uint32_t queued = 0;
+	MOVE frame[TARGET_COUNT];		/* 当前帧合并后的移动 */
+	uint32_t count = 0, current = 0;
+	uint64_t remaining = 0;		/* 当前移动剩余的耗时，0 表示尚未开始 */
+
+	while (!done()) {
+		uint64_t next = arrival(decoded);
+		if (next <= t) {
+			/* 输入任务：解码 */
+			t += decode_ns;
+			decoded++;
+			cursor_updated = window_updated = true;
+		} else if (cursor_updated || window_updated) {
+			/* 输入任务：提交请求；队列只保留每个图层最后的一个，与合并后的结果相同 */
+			for (uint32_t target = 0; target < TARGET_COUNT; target++) {
+				if (!(target == TARGET_CURSOR ? cursor_updated : window_updated))
+					continue;
+				uint32_t i = 0;
+				while (i < queued && queue[i].target != target)
+					i++;
+				queue[i] = (MOVE) { target, decoded - 1 };
+				if (i == queued)
+					queued++;
+			}
+			cursor_updated = window_updated = false;
+		} else if (current < count) {
+			/* 合成任务：执行当前帧的移动，到下一个数据包到达时被抢占 */
+			if (!remaining)
+				remaining = timed_move(frame[current].target, frame[current].packet);
+			uint64_t run = next - t < remaining ? next - t : remaining;
+			t += run;
+			remaining -= run;
+			if (!remaining) {
+				show(frame[current].target, frame[current].packet, t);
+				current++;
+			}
+		} else if (queued) {
+			/* 合成任务：取出全部请求作为新的一帧 */
+			memcpy(frame, queue, queued * sizeof(MOVE));
+			count = queued;
+			current = 0;
+			queued = 0;
+		} else {
+			t = next;
+		}
+	}
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* 以微秒输出各数据包自到达至画面反映的延迟分位数 */
+static void report(const char *name, uint64_t elapsed_moves)
+{
+	printf("%-12s%llu layer_move calls\n", name, (unsigned long long) elapsed_moves);
+	for (uint32_t target = 0; target < TARGET_COUNT; target++) {
+		uint64_t *latency = malloc(packets * sizeof(uint64_t));
+		for (uint32_t k = 0; k < packets; k++)
+			latency[k] = photon[target][k] - arrival(k);
+		qsort(latency, packets, sizeof(uint64_t), compare_u64);
+		printf("  %-10sp50 %.1f us, p99 %.1f us, max %.1f us\n", target == TARGET_CURSOR ? "cursor" : "window",
+			latency[(packets - 1) / 2] / 1000.0, latency[(packets - 1) * 99 / 100] / 1000.0,
+			latency[packets - 1] / 1000.0);
+		free(latency);
+	}
+}
+
+/* 构造桌面：背景、两个静止的窗口、被拖动的窗口与光标，自下而上 */
+static void desktop_init(uint16_t width, uint16_t height)
+{
+	static const struct { uint16_t w, h; int16_t x, y; } statics[] = {
+		{ SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0 },
+		{ 480, 300, 100, 80 },
+		{ 480, 300, 640, 400 },
+	};
+
+	int32_t z = 0;
+	for (uint32_t i = 0; i < sizeof(statics) / sizeof(statics[0]); i++, z++) {
+		LAYER *layer = layer_alloc(statics[i].w, statics[i].h, false);
+		for (uint32_t p = 0; p < (uint32_t) statics[i].w * statics[i].h; p++)
+			layer->buf[p] = 0xff000000 | (i * 0x404040);
+		layer_move(layer, statics[i].x, statics[i].y);
+		layer_set_z(layer, z);
+	}
+
+	layers[TARGET_WINDOW] = layer_alloc(width, height, false);
+	layers[TARGET_CURSOR] = layer_alloc(CURSOR_SIZE, CURSOR_SIZE, true);
+	for (uint32_t p = 0; p < (uint32_t) width * height; p++)
+		layers[TARGET_WINDOW]->buf[p] = 0xffc0c0c0;
+	for (uint32_t p = 0; p < CURSOR_SIZE * CURSOR_SIZE; p++)
+		layers[TARGET_CURSOR]->buf[p] = 0xffffffff;
+	layer_set_z(layers[TARGET_WINDOW], z++);
+	layer_set_z(layers[TARGET_CURSOR], z);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n packets] [-i interval_us] [-d decode_ns] [-W width] [-H height]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t width = DEFAULT_WIDTH, height = DEFAULT_HEIGHT;
+	packets = DEFAULT_PACKETS;
+	interval = DEFAULT_INTERVAL_US * 1000ull;
+	decode_ns = DEFAULT_DECODE_NS;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:i:d:W:H:h")) != -1) {
+		switch (opt) {
+			case 'n': packets = strtoul(optarg, NULL, 0); break;
+			case 'i': interval = strtoull(optarg, NULL, 0) * 1000; break;
+			case 'd': decode_ns = strtoull(optarg, NULL, 0); break;
+			case 'W': width = strtoul(optarg, NULL, 0); break;
+			case 'H': height = strtoul(optarg, NULL, 0); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || !packets || !interval || !width || !height ||
+		width > SCREEN_WIDTH || height > SCREEN_HEIGHT) usage(argv[0]);
+
+	size_t pool_size = (size_t) POOL_MIB << 20;
+	void *pool = aligned_alloc(SLAB_SIZE, pool_size);
+	uint32_t *fb = calloc((size_t) SCREEN_WIDTH * SCREEN_HEIGHT, sizeof(uint32_t));
+	photon[TARGET_CURSOR] = malloc(packets * sizeof(uint64_t));
+	photon[TARGET_WINDOW] = malloc(packets * sizeof(uint64_t));
+	if (!pool || !fb || !photon[TARGET_CURSOR] || !photon[TARGET_WINDOW]) {
+		perror("alloc");
+		return 1;
+	}
+	memory_init(&g_mp, pool, pool_size);
+	kmem_init();
+	g_fb.addr = (uintptr_t) fb;
+	layer_init(fb, SCREEN_WIDTH, SCREEN_HEIGHT);
+	desktop_init(width, height);
+
+	printf("drag        %ux%u window on %ux%u, %u packets every %llu us, decode %llu ns\n",
+		width, height, SCREEN_WIDTH, SCREEN_HEIGHT, packets,
+		(unsigned long long) (interval / 1000), (unsigned long long) decode_ns);
+
+	run_before();
+	report("before", moves);
+
+	memset(shown, 0, sizeof(shown));
+	moves = 0;
+	run_after();
+	report("after", moves);
+	return 0;
+}
@@ -0,0 +1,413 @@
+/*
+	bench/idle_bench.c
+
+	空闲中断的主机端基准测试：将 devices/pit.c 与 utilities/timer.c 编译为 Linux 程序，
+	以模拟的 8254 通道 0 代替硬件，按空闲任务的循环推进时间，
+	分别统计保持周期中断与进入无滴答模式时每秒的 PIT 中断次数，并核对补记的滴答是否与实际经过的时间一致。
+	同时以主机时钟测量 isr_pit 自进入至发送 EOI、至返回的耗时，以及其间经串口输出的调试信息字节数。
+*/
+
+/* 主机头文件须先于内核头文件包含，以免其中的声明被 io.h 替身中的同名宏改写 */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* POSIX 的 timer_create 与 timer_delete 与内核接口同名，包含 time.h 时改名回避 */
+#define timer_create						posix_timer_create
+#define timer_delete						posix_timer_delete
+#include <time.h>
+#undef timer_create
+#undef timer_delete
+
+#include <ClassiX/interrupt.h>
+#include <ClassiX/memory.h>
+#include <ClassiX/pit.h>
+#include <ClassiX/slab.h>
+#include <ClassiX/timer.h>
+#include <ClassiX/typedef.h>
+#include <ClassiX/workqueue.h>
+
+#define DEFAULT_SECONDS						(600)		/* 默认模拟的时长（秒） */
+#define DEFAULT_FREQUENCY					(1000)		/* 默认的 PIT 频率，与 main.c 一致 */
+#define MAX_TIMERS							(16)		/* -t 可指定的定时器数量上限 */
+#define POOL_MIB							(4)			/* 内存池大小 */
+#define NEVER								(UINT64_MAX)
+#define UART_BAUD							(115200)	/* 与 serial.c 一致，每字节 10 位 */
+
+/* 模拟的 8254 通道 0，时间以 PIT 输入时钟计 */
+static struct {
+	uint64_t now;			/* 当前时刻 */
+	uint8_t mode;			/* PIT_CMD_MODE0 或 PIT_CMD_MODE2 */
+	uint32_t reload;		/* 写入的计数值，0 表示 65536 */
+	uint64_t start;			/* 开始计数的时刻 */
+	uint64_t next_irq;		/* 下一次 OUT 上升沿的时刻 */
+	bool write_high;		/* 下一次写入为高字节 */
+	uint8_t write_low;		/* 已写入的低字节 */
+	uint8_t latch[3];		/* 锁存的状态与计数值，按读出顺序排列 */
+	uint32_t latched;		/* 待读出的锁存字节数 */
+} pit;
+
+/* 模拟的 PIC 中断请求寄存器：OUT 的上升沿置位，处理中断时清除 */
+static bool irq_pending;
+
+/* 空闲任务之外的唤醒（键盘、鼠标等中断） */
+static uint64_t wakeups;
+
+/* 中断处理程序的计时，以主机时钟的纳秒计 */
+static uint64_t eoi_ns;				/* 发送 EOI 的时刻 */
+static uint64_t callback_ns;		/* 每次回调忙等待的时长 */
+extern uint64_t bench_uart_bytes;	/* stubs.c 统计的调试输出字节数 */
+
+/* 工作线程替身：提交的工作项在中断返回后、空闲任务继续之前依次执行，与 PRIORITY_HIGH 的工作线程抢占空闲任务一致 */
+static WORK *work_head, *work_tail;
+
+/* 调度器替身：空闲时没有其他任务，不发生调度 */
+volatile uint64_t next_schedule_tick = NEVER;
+
+void task_preempt_disable(void) {}
+void task_preempt_enable(void) {}
+void task_schedule(void) {}
+
+/* 模拟的 CPU 不支持 TSC，pit.c 不做校准，时钟按滴答换算 */
+bool check_tsc_support(void)
+{
+	return false;
+}
+
+void idt_set_gate(uint8_t num, uint32_t base, uint16_t selector, uint32_t ar) {}
+void asm_isr_pit(void) {}
+void isr_pit(ISR_PARAMS *params);
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+bool work_queue(WORK *work)
+{
+	if (work->pending)
+		return false;
+	work->pending = true;
+	work->next = NULL;
+	if (work_tail)
+		work_tail->next = work;
+	else
+		work_head = work;
+	work_tail = work;
+	return true;
+}
+
+bool work_cancel(WORK *work)
+{
+	if (!work->pending)
+		return false;
+	WORK **link = &work_head;
+	WORK *prev = NULL;
+	while (*link != work) {
+		prev = *link;
+		link = &prev->next;
+	}
+	*link = work->next;
+	if (work_tail == work)
+		work_tail = prev;
+	work->pending = false;
+	return true;
+}
+
+bool work_busy(const WORK *work)
+{
+	return work->pending;
+}
+
+static void work_run(void)
+{
+	while (work_head) {
+		WORK *work = work_head;
+		work_head = work->next;
+		if (!work_head)
+			work_tail = NULL;
+		work->pending = false;
+		work->func(work->arg);
+	}
+}
+
+/* 当前时刻的计数值 */
+static uint16_t pit_count(void)
+{
+	uint64_t elapsed = pit.now - pit.start;
+	uint32_t reload = pit.reload ? pit.reload : 0x10000;
+	if (pit.mode == PIT_CMD_MODE2)
+		return (uint16_t) (reload - elapsed % reload);	/* 从分频值递减至 1 */
+	return (uint16_t) (reload - elapsed);				/* 到 0 后从 0xffff 继续递减 */
+}
+
+/* 模式 2 周期性产生上升沿，模式 0 只在计数到 0 时产生一次 */
+static bool pit_out(void)
+{
+	uint32_t reload = pit.reload ? pit.reload : 0x10000;
+	return pit.mode == PIT_CMD_MODE2 || pit.now - pit.start >= reload;
+}
+
+/* 推进到 time，其间的上升沿置位中断请求 */
+static void pit_advance(uint64_t time)
+{
+	pit.now = time;
+	if (pit.next_irq > pit.now)
+		return;
+
+	irq_pending = true;
+	if (pit.mode == PIT_CMD_MODE2) {
+		uint32_t reload = pit.reload ? pit.reload : 0x10000;
+		pit.next_irq += ((pit.now - pit.next_irq) / reload + 1) * reload;
+	} else {
+		pit.next_irq = NEVER;
+	}
+}
+
+void bench_out8(uint32_t port, uint8_t data)
+{
+	if (port == PIC0_OCW2) {
+		eoi_ns = now_ns();
+	} else if (port == PIT_COMMAND) {
+		if ((data & 0xc0) == PIT_CMD_READBACK) {
+			/* 读回：位 5、位 4 为 0 时分别锁存计数值与状态 */
+			if (!(data & PIT_READBACK_CH0))
+				return;
+			uint16_t count = pit_count();
+			pit.latched = 0;
+			if (!(data & 0x10))
+				pit.latch[pit.latched++] = (pit_out() ? PIT_STATUS_OUT : 0) | PIT_CMD_LOHI | pit.mode;
+			if (!(data & 0x20)) {
+				pit.latch[pit.latched++] = count & 0xff;
+				pit.latch[pit.latched++] = count >> 8;
+			}
+		} else if ((data & 0xc0) == PIT_CMD_CH0) {
+			if ((data & 0x30) == PIT_CMD_LATCH) {
+				uint16_t count = pit_count();
+				pit.latch[0] = count & 0xff;
+				pit.latch[1] = count >> 8;
+				pit.latched = 2;
+			} else {
+				/* 设置模式后等待写入计数值，模式 0 的 OUT 随即变为低电平 */
+				pit.mode = data & 0x0e;
+				pit.write_high = false;
+				pit.next_irq = NEVER;
+			}
+		}
+	} else if (port == PIT_CHANNEL0) {
+		if (!pit.write_high) {
+			pit.write_low = data;
+			pit.write_high = true;
+			return;
+		}
+		pit.write_high = false;
+		pit.reload = pit.write_low | (uint32_t) data << 8;
+		pit.start = pit.now;
+		pit.next_irq = pit.now + (pit.reload ? pit.reload : 0x10000);
+	}
+}
+
+uint8_t bench_in8(uint32_t port)
+{
+	if (port != PIT_CHANNEL0 || !pit.latched)
+		return 0;
+
+	uint8_t value = pit.latch[0];
+	memmove(pit.latch, pit.latch + 1, --pit.latched);
+	return value;
+}
+
+/* 回调忙等待 -c 指定的时长，模拟唤醒任务等工作 */
+static void timer_callback(void *arg)
+{
+	uint64_t end = now_ns() + callback_ns;
+	while (callback_ns && now_ns() < end) { }
+}
+
+typedef struct {
+	uint64_t interrupts;	/* PIT 中断次数 */
+	uint32_t oneshots;		/* 进入单次触发模式的次数 */
+	int64_t drift;			/* 系统滴答与实际经过的滴答之差 */
+	uint64_t *eoi;			/* 每次中断自进入至 EOI 的纳秒数 */
+	uint64_t *handler;		/* 每次中断自进入至返回的纳秒数 */
+	uint64_t uart_bytes;	/* 中断内输出调试信息的总字节数 */
+	uint64_t uart_max;		/* 一次中断内输出调试信息的最多字节数 */
+} result_t;
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* 升序排列后取分位数 */
+static uint64_t percentile(uint64_t *samples, uint64_t count, uint32_t pct)
+{
+	return count ? samples[(count - 1) * pct / 100] : 0;
+}
+
+/* 复现空闲任务的循环：可选地进入无滴答模式，开中断等待下一个中断，醒来后退出无滴答模式 */
+static result_t run(bool tickless, uint32_t frequency, uint64_t seconds, uint32_t wake_rate,
+	const uint32_t *intervals, uint32_t count, uint32_t flags)
+{
+	TIMER *timers[MAX_TIMERS];
+	result_t result = { 0 };
+	uint64_t capacity = seconds * frequency + 1;
+
+	/* 周期模式每秒 frequency 次中断，无滴答模式更少 */
+	result.eoi = malloc(capacity * sizeof(uint64_t));
+	result.handler = malloc(capacity * sizeof(uint64_t));
+	if (!result.eoi || !result.handler) {
+		perror("alloc");
+		exit(1);
+	}
+
+	memset(&pit, 0, sizeof(pit));
+	memset(&pit_stats, 0, sizeof(pit_stats));
+	irq_pending = false;
+	wakeups = 0;
+
+	/* 定时器时间轮随系统滴答前进，不能回拨，各轮从上一轮结束时的滴答继续 */
+	init_pit(frequency);
+	uint64_t ticks = get_system_ticks();
+	for (uint32_t i = 0; i < count; i++) {
+		timers[i] = timer_create(timer_callback, NULL, flags);
+		timer_start(timers[i], (uint64_t) intervals[i] * frequency / 1000, -1);
+	}
+
+	/* 外部唤醒的间隔服从指数分布 */
+	uint64_t end = seconds * PIT_BASE_FREQ;
+	uint64_t next_wake = NEVER;
+	srand(1);
+	if (wake_rate)
+		next_wake = (uint64_t) (-log1p(-rand() / (RAND_MAX + 1.0)) * PIT_BASE_FREQ / wake_rate) + 1;
+
+	while (pit.now < end) {
+		cli();
+		if (tickless)
+			pit_tickless_enter(timer_next_expiry());
+		sti();
+
+		/* hlt：等到 PIT 或外部中断 */
+		uint64_t wake = pit.next_irq < next_wake ? pit.next_irq : next_wake;
+		pit_advance(wake < end ? wake : end);
+		if (irq_pending) {
+			irq_pending = false;
+			uint64_t bytes = bench_uart_bytes;
+			uint64_t entry = now_ns();
+			isr_pit(NULL);
+			uint64_t done = now_ns();
+			if (pit_stats.interrupts <= capacity) {
+				result.eoi[pit_stats.interrupts - 1] = eoi_ns - entry;
+				result.handler[pit_stats.interrupts - 1] = done - entry;
+			}
+			result.uart_bytes += bench_uart_bytes - bytes;
+			if (bench_uart_bytes - bytes > result.uart_max)
+				result.uart_max = bench_uart_bytes - bytes;
+			work_run();
+		}
+		if (pit.now >= next_wake) {
+			wakeups++;
+			next_wake = pit.now + (uint64_t) (-log1p(-rand() / (RAND_MAX + 1.0)) * PIT_BASE_FREQ / wake_rate) + 1;
+		}
+
+		cli();
+		pit_tickless_exit();
+		sti();
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+		timer_delete(timers[i]);
+
+	/* 周期模式从 init_pit 起计数，每个分频值记一个滴答 */
+	uint32_t divisor = PIT_BASE_FREQ / frequency;
+	result.interrupts = pit_stats.interrupts;
+	result.oneshots = pit_stats.tickless_entries;
+	result.drift = (int64_t) (get_system_ticks() - ticks) - (int64_t) (pit.now / divisor);
+
+	uint64_t samples = result.interrupts < capacity ? result.interrupts : capacity;
+	qsort(result.eoi, samples, sizeof(uint64_t), compare_u64);
+	qsort(result.handler, samples, sizeof(uint64_t), compare_u64);
+	return result;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s seconds] [-f hz] [-k wakeups_per_s] [-c callback_ns] [-w] [-t interval_ms]...\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t seconds = DEFAULT_SECONDS;
+	uint32_t frequency = DEFAULT_FREQUENCY;
+	uint32_t wake_rate = 0;
+	uint32_t intervals[MAX_TIMERS];
+	uint32_t count = 0;
+	uint32_t flags = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:f:k:c:wt:h")) != -1) {
+		switch (opt) {
+			case 's': seconds = strtoull(optarg, NULL, 0); break;
+			case 'f': frequency = strtoul(optarg, NULL, 0); break;
+			case 'k': wake_rate = strtoul(optarg, NULL, 0); break;
+			case 'c': callback_ns = strtoull(optarg, NULL, 0); break;
+			case 'w': flags |= TIMER_FLAG_WORKER; break;
+			case 't':
+				if (count == MAX_TIMERS) usage(argv[0]);
+				intervals[count++] = strtoul(optarg, NULL, 0);
+				break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || !seconds || !frequency || frequency > PIT_BASE_FREQ) usage(argv[0]);
+	for (uint32_t i = 0; i < count; i++)
+		if ((uint64_t) intervals[i] * frequency < 1000) usage(argv[0]);
+
+	size_t pool_size = (size_t) POOL_MIB << 20;
+	void *pool = aligned_alloc(SLAB_SIZE, pool_size);
+	if (!pool) {
+		perror("alloc");
+		return 1;
+	}
+	memory_init(&g_mp, pool, pool_size);
+	kmem_init();
+
+	result_t periodic = run(false, frequency, seconds, wake_rate, intervals, count, flags);
+	result_t tickless = run(true, frequency, seconds, wake_rate, intervals, count, flags);
+
+	printf("idle        %llu s at %u Hz, %u external wake-ups/s, timers:",
+		(unsigned long long) seconds, frequency, wake_rate);
+	if (!count)
+		printf(" none");
+	for (uint32_t i = 0; i < count; i++)
+		printf(" %u ms", intervals[i]);
+	if (count)
+		printf(", callbacks %llu ns%s", (unsigned long long) callback_ns, flags & TIMER_FLAG_WORKER ? " on the worker" : " in the interrupt");
+	printf("\n");
+	printf("periodic    %.1f irq/s, tick drift %lld\n",
+		(double) periodic.interrupts / seconds, (long long) periodic.drift);
+	printf("tickless    %.1f irq/s, %u one-shots, tick drift %lld\n",
+		(double) tickless.interrupts / seconds, tickless.oneshots, (long long) tickless.drift);
+	printf("ratio       %.1fx fewer interrupts\n", (double) periodic.interrupts / tickless.interrupts);
+
+	/* 中断处理程序的耗时取周期模式一轮，样本最多 */
+	uint64_t samples = periodic.interrupts < seconds * frequency + 1 ? periodic.interrupts : seconds * frequency + 1;
+	printf("eoi         p50 %llu ns, p99 %llu ns, max %llu ns (entry to EOI)\n",
+		(unsigned long long) percentile(periodic.eoi, samples, 50),
+		(unsigned long long) percentile(periodic.eoi, samples, 99),
+		(unsigned long long) percentile(periodic.eoi, samples, 100));
+	printf("handler     p50 %llu ns, p99 %llu ns, max %llu ns (entry to return)\n",
+		(unsigned long long) percentile(periodic.handler, samples, 50),
+		(unsigned long long) percentile(periodic.handler, samples, 99),
+		(unsigned long long) percentile(periodic.handler, samples, 100));
+	printf("serial      avg %.1f, max %llu bytes per interrupt, max %llu us at %u baud\n",
+		(double) periodic.uart_bytes / periodic.interrupts, (unsigned long long) periodic.uart_max,
+		(unsigned long long) (periodic.uart_max * 10 * 1000000 / UART_BAUD), UART_BAUD);
+	return 0;
+}
@@ -0,0 +1,46 @@
+/*
+	bench/include/ClassiX/io.h
+
+	主机端替身：屏蔽 source/include/ClassiX/io.h 中的特权指令，
+	使内存管理代码可以在 Linux 用户态编译运行。中断允许标志由 bench_eflags 模拟，
+	8 位端口读写转发到 bench_out8 / bench_in8，由需要模拟设备的基准测试提供。
+*/
+
+#ifndef _CLASSIX_IO_H_
+#define _CLASSIX_IO_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <ClassiX/typedef.h>
+
+#define EFLAGS_IF							(1 << 9)	/* 中断允许标志 */
+
+extern uint32_t bench_eflags;		/* 模拟的 EFLAGS，仅 IF 位有意义 */
+
+void bench_out8(uint32_t port, uint8_t data);
+uint8_t bench_in8(uint32_t port);
+
+#define hlt()								((void) 0)
+#define cli()								((void) (bench_eflags &= ~EFLAGS_IF))
+#define sti()								((void) (bench_eflags |= EFLAGS_IF))
+#define nop()								((void) 0)
+#define pause()								((void) 0)
+
+#define out8(port, data)					bench_out8((port), (data))
+#define out16(port, data)					((void) (port), (void) (data))
+#define out32(port, data)					((void) (port), (void) (data))
+
+#define in8(port)							bench_in8(port)
+#define in16(port)							((void) (port), (uint16_t) 0)
+#define in32(port)							((void) (port), (uint32_t) 0)
+
+#define store_eflags(eflags)				((void) (bench_eflags = (eflags)))
+#define load_eflags()						(bench_eflags)
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+/*
+	bench/stubs.c
+
+	主机端替身：为 core/memory.c、core/slab.c 与 utilities/timer.c 提供其依赖的内核符号。
+	时钟与端口相关的替身为弱符号，idle_bench 链接 devices/pit.c 及模拟的 PIT 时以之取代。
+*/
+
+/* 主机头文件须先于内核头文件包含，以免其中的声明被 io.h 替身中的同名宏改写 */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <x86intrin.h>
+
+#include <ClassiX/cpu.h>
+#include <ClassiX/io.h>
+#include <ClassiX/page.h>
+#include <ClassiX/task.h>
+#include <ClassiX/typedef.h>
+#include <ClassiX/workqueue.h>
+
+uint32_t bench_eflags = EFLAGS_IF;
+
+/* 模拟的系统滴答，由 timer_bench 推进 */
+uint64_t bench_ticks;
+uint32_t __attribute__((weak)) pit_frequency = 1000;
+
+/* 主机均支持 TSC，非零即可启用内核堆的关中断计时 */
+uint32_t __attribute__((weak)) tsc_khz = 1;
+
+/* 内核经串口输出的调试信息字节数 */
+uint64_t bench_uart_bytes;
+
+/* 统计输出的字节数；设置环境变量 BENCH_VERBOSE 后转发内核调试输出 */
+int32_t uart_printf(const char *format, ...)
+{
+	static int verbose = -1;
+	if (verbose < 0)
+		verbose = getenv("BENCH_VERBOSE") != NULL;
+
+	va_list va;
+	va_start(va, format);
+	int32_t result = verbose ? vfprintf(stderr, format, va) : vsnprintf(NULL, 0, format, va);
+	va_end(va);
+	if (result > 0)
+		bench_uart_bytes += result;
+	return result;
+}
+
+uint64_t rdtsc(void)
+{
+	return __rdtsc();
+}
+
+uint64_t __attribute__((weak)) get_system_ticks(void)
+{
+	return bench_ticks;
+}
+
+/* 没有模拟的设备，端口写入被丢弃，读出 0 */
+void __attribute__((weak)) bench_out8(uint32_t port, uint8_t data)
+{
+}
+
+uint8_t __attribute__((weak)) bench_in8(uint32_t port)
+{
+	return 0;
+}
+
+/* 基准测试不模拟任务，所有分配均不属于任何任务 */
+TASK *task_get_current(void)
+{
+	return NULL;
+}
+
+TASK *task_iterate(TASK *prev)
+{
+	return NULL;
+}
+
+void task_sleep_ms(uint32_t ms)
+{
+}
+
+/* 主机上没有 multiboot 内存图，页分配器始终失败，大请求回落到内核内存池 */
+void *page_alloc_size(size_t size)
+{
+	return NULL;
+}
+
+void page_free(void *addr)
+{
+}
+
+bool page_owns(const void *addr)
+{
+	return false;
+}
+
+size_t page_block_size(const void *addr)
+{
+	return 0;
+}
+
+/* 基准测试没有工作线程，提交的工作项立即执行；idle_bench 以推迟执行的版本取代 */
+void work_init(WORK *work, WORK_FUNC func, void *arg)
+{
+	work->func = func;
+	work->arg = arg;
+	work->next = NULL;
+	work->pending = false;
+}
+
+bool __attribute__((weak)) work_queue(WORK *work)
+{
+	work->func(work->arg);
+	return true;
+}
+
+bool __attribute__((weak)) work_cancel(WORK *work)
+{
+	return false;
+}
+
+bool __attribute__((weak)) work_busy(const WORK *work)
+{
+	return false;
+}
@@ -0,0 +1,247 @@
+/*
+	bench/switch_bench.c
+
+	任务切换的主机端基准测试：两个执行流在各自的栈上往返切换，比较 core/switch.asm 的软件切换
+	与按硬件任务切换步骤模拟的 TSS 切换。硬件任务切换（经 TSS 的远跳转）无法在用户态执行，
+	后者只模拟其中可在用户态完成的部分，结果是旧路径开销的下界。
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#define DEFAULT_SWITCHES					(1000000)	/* 默认每轮的往返次数 */
+#define DEFAULT_ROUNDS						(5)			/* 默认轮数，取最快一轮 */
+#define PEER_STACK_SIZE						(64 * 1024)	/* 对端执行流的栈大小 */
+
+/*
+	与 _context_switch 相同的步骤：压入标志寄存器、被调用者保存的寄存器与两个段寄存器，交换栈指针后逆序弹出。
+	x86-64 的被调用者保存寄存器为 rbp、rbx、r12 ~ r15；64 位模式下 fs、gs 的基址承载线程局部存储，
+	改为保存并重新加载 ds、es，段寄存器加载的描述符检查开销相同。
+*/
+void stack_switch(uint64_t *prev_rsp, uint64_t next_rsp);
+__asm__(
+	".text\n"
+	".globl stack_switch\n"
+	"stack_switch:\n"
+	"	pushfq\n"
+	"	push %rbp\n"
+	"	push %rbx\n"
+	"	push %r12\n"
+	"	push %r13\n"
+	"	push %r14\n"
+	"	push %r15\n"
+	"	mov %ds, %eax\n"
+	"	push %rax\n"
+	"	mov %es, %eax\n"
+	"	push %rax\n"
+	"	mov %rsp, (%rdi)\n"
+	"	mov %rsi, %rsp\n"
+	"	pop %rax\n"
+	"	mov %eax, %es\n"
+	"	pop %rax\n"
+	"	mov %eax, %ds\n"
+	"	pop %r15\n"
+	"	pop %r14\n"
+	"	pop %r13\n"
+	"	pop %r12\n"
+	"	pop %rbx\n"
+	"	pop %rbp\n"
+	"	popfq\n"
+	"	ret\n");
+
+/* 模拟的任务状态段，字段对应 i386 TSS 中硬件任务切换读写的部分 */
+typedef struct {
+	uint64_t rip, rflags;
+	uint64_t rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi;
+	uint64_t r12, r13, r14, r15;
+	uint64_t es, cs, ss, ds, fs, gs;
+	uint32_t busy;		/* 模拟 GDT 中 TSS 描述符的忙标志 */
+} tss_image_t;
+
+/*
+	按硬件任务切换的顺序：将全部通用寄存器、标志寄存器、返回地址与段选择子写入当前 TSS，
+	以加锁的读改写清除旧 TSS、置位新 TSS 的忙标志，再从新 TSS 读出寄存器，
+	重新加载 ds、es、ss，最后以远返回重新加载 cs 并跳转到新的指令指针。
+	CR3、LDTR 的加载与 CR0.TS 的置位为特权操作，不在模拟之列。
+*/
+void tss_switch(tss_image_t *prev, tss_image_t *next);
+__asm__(
+	".text\n"
+	".globl tss_switch\n"
+	"tss_switch:\n"
+	"	pop %rax\n"
+	"	mov %rax, 0(%rdi)\n"
+	"	pushfq\n"
+	"	popq 8(%rdi)\n"
+	"	mov %rax, 16(%rdi)\n"
+	"	mov %rcx, 24(%rdi)\n"
+	"	mov %rdx, 32(%rdi)\n"
+	"	mov %rbx, 40(%rdi)\n"
+	"	mov %rsp, 48(%rdi)\n"
+	"	mov %rbp, 56(%rdi)\n"
+	"	mov %rsi, 64(%rdi)\n"
+	"	mov %rdi, 72(%rdi)\n"
+	"	mov %r12, 80(%rdi)\n"
+	"	mov %r13, 88(%rdi)\n"
+	"	mov %r14, 96(%rdi)\n"
+	"	mov %r15, 104(%rdi)\n"
+	"	mov %es, 112(%rdi)\n"
+	"	mov %cs, 120(%rdi)\n"
+	"	mov %ss, 128(%rdi)\n"
+	"	mov %ds, 136(%rdi)\n"
+	"	mov %fs, 144(%rdi)\n"
+	"	mov %gs, 152(%rdi)\n"
+	"	lock btrl $0, 160(%rdi)\n"
+	"	lock btsl $0, 160(%rsi)\n"
+	"	mov 24(%rsi), %rcx\n"
+	"	mov 32(%rsi), %rdx\n"
+	"	mov 40(%rsi), %rbx\n"
+	"	mov 56(%rsi), %rbp\n"
+	"	mov 80(%rsi), %r12\n"
+	"	mov 88(%rsi), %r13\n"
+	"	mov 96(%rsi), %r14\n"
+	"	mov 104(%rsi), %r15\n"
+	"	mov 112(%rsi), %es\n"
+	"	mov 136(%rsi), %ds\n"
+	"	mov 128(%rsi), %ss\n"
+	"	mov 48(%rsi), %rsp\n"
+	"	pushq 8(%rsi)\n"
+	"	popfq\n"
+	"	pushq 120(%rsi)\n"
+	"	pushq 0(%rsi)\n"
+	"	mov 16(%rsi), %rax\n"
+	"	mov 72(%rsi), %rdi\n"
+	"	mov 64(%rsi), %rsi\n"
+	"	lretq\n");
+
+static uint64_t main_rsp, peer_rsp;
+static tss_image_t main_tss, peer_tss;
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* 对端执行流：切换回发起者，永不返回 */
+static void __attribute__((noreturn)) stack_peer(void)
+{
+	for (;;)
+		stack_switch(&peer_rsp, main_rsp);
+}
+
+static void __attribute__((noreturn)) tss_peer(void)
+{
+	for (;;)
+		tss_switch(&peer_tss, &main_tss);
+}
+
+/* 栈顶按函数入口的约定对齐：ret 弹出入口地址后 rsp 模 16 余 8 */
+static uint64_t *peer_stack_top(void)
+{
+	static uint64_t stack[PEER_STACK_SIZE / sizeof(uint64_t)] __attribute__((aligned(16)));
+	return &stack[PEER_STACK_SIZE / sizeof(uint64_t) - 1];
+}
+
+/* 按 stack_switch 弹出的顺序构造对端的初始栈 */
+static void stack_init(void)
+{
+	uint64_t *sp = peer_stack_top();
+	uint64_t ds, es;
+	__asm__ volatile ("mov %%ds, %0; mov %%es, %1" : "=r" (ds), "=r" (es));
+
+	*--sp = (uint64_t) stack_peer;
+	*--sp = 0x202;				/* rflags */
+	for (int i = 0; i < 6; i++)
+		*--sp = 0;				/* rbp、rbx、r12 ~ r15 */
+	*--sp = ds;
+	*--sp = es;
+	peer_rsp = (uint64_t) sp;
+}
+
+/* 对端的 TSS 取当前的段选择子，入口与栈指针指向 tss_peer */
+static void tss_init(void)
+{
+	__asm__ volatile (
+		"mov %%es, %0; mov %%cs, %1; mov %%ss, %2; mov %%ds, %3; mov %%fs, %4; mov %%gs, %5"
+		: "=r" (peer_tss.es), "=r" (peer_tss.cs), "=r" (peer_tss.ss),
+		  "=r" (peer_tss.ds), "=r" (peer_tss.fs), "=r" (peer_tss.gs));
+	peer_tss.rip = (uint64_t) tss_peer;
+	peer_tss.rflags = 0x202;
+	peer_tss.rsp = (uint64_t) peer_stack_top();
+	main_tss.busy = 1;
+}
+
+typedef struct {
+	uint64_t cycles;
+	uint64_t ns;
+} result_t;
+
+/* 往返 count 次，即切换 2 * count 次，返回最快一轮的总耗时 */
+static result_t run(int tss, uint32_t count, uint32_t rounds)
+{
+	result_t best = { UINT64_MAX, UINT64_MAX };
+
+	if (tss)
+		tss_init();
+	else
+		stack_init();
+
+	for (uint32_t r = 0; r < rounds; r++) {
+		uint64_t ns = now_ns();
+		uint64_t cycles = __rdtsc();
+		if (tss) {
+			for (uint32_t i = 0; i < count; i++)
+				tss_switch(&main_tss, &peer_tss);
+		} else {
+			for (uint32_t i = 0; i < count; i++)
+				stack_switch(&main_rsp, peer_rsp);
+		}
+		cycles = __rdtsc() - cycles;
+		ns = now_ns() - ns;
+
+		if (cycles < best.cycles) {
+			best.cycles = cycles;
+			best.ns = ns;
+		}
+	}
+	return best;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n switches] [-r rounds]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t count = DEFAULT_SWITCHES;
+	uint32_t rounds = DEFAULT_ROUNDS;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:h")) != -1) {
+		switch (opt) {
+			case 'n': count = strtoul(optarg, NULL, 0); break;
+			case 'r': rounds = strtoul(optarg, NULL, 0); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || !count || !rounds) usage(argv[0]);
+
+	result_t stack = run(0, count, rounds);
+	result_t tss = run(1, count, rounds);
+
+	printf("switches    %u round trips x %u rounds, fastest round\n", count, rounds);
+	printf("stack       %.1f cycles, %.1f ns per switch (context_switch)\n",
+		(double) stack.cycles / (2.0 * count), (double) stack.ns / (2.0 * count));
+	printf("tss-emu     %.1f cycles, %.1f ns per switch (TSS far jump, lower bound)\n",
+		(double) tss.cycles / (2.0 * count), (double) tss.ns / (2.0 * count));
+	printf("ratio       %.2fx\n", (double) tss.cycles / stack.cycles);
+	return 0;
+}
@@ -0,0 +1,160 @@
+/*
+	bench/timer_bench.c
+
+	定时器的主机端基准测试：将 utilities/timer.c 编译为 Linux 程序，
+	启动大量周期定时器后逐个滴答调用 timer_process，报告各接口的耗时，
+	并核对每次回调是否恰好发生在预期的滴答。
+*/
+
+/* 主机头文件须先于内核头文件包含，以免其中的声明被 io.h 替身中的同名宏改写 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* POSIX 的 timer_create 与 timer_delete 与内核接口同名，包含 time.h 时改名回避 */
+#define timer_create						posix_timer_create
+#define timer_delete						posix_timer_delete
+#include <time.h>
+#undef timer_create
+#undef timer_delete
+
+#include <ClassiX/memory.h>
+#include <ClassiX/slab.h>
+#include <ClassiX/timer.h>
+#include <ClassiX/typedef.h>
+
+#define DEFAULT_TIMERS						(10000)		/* 默认定时器数量 */
+#define DEFAULT_TICKS						(600000)	/* 默认模拟的滴答数，1000 Hz 下为 10 分钟 */
+#define DEFAULT_MAX_INTERVAL				(60000)		/* 默认最大触发间隔 */
+#define DEFAULT_SEED						(1)			/* 默认随机种子 */
+#define POOL_MIB							(16)		/* 内存池大小 */
+#define RESTART_OPS							(100000)	/* 停止并重新启动的次数 */
+#define NEXT_EXPIRY_CALLS					(10000)		/* timer_next_expiry 的调用次数 */
+
+extern uint64_t bench_ticks;
+
+typedef struct {
+	TIMER *timer;
+	uint64_t interval;
+	uint64_t expected;		/* 预期的下一次到期滴答 */
+} slot_t;
+
+static slot_t *slots;
+static uint64_t callbacks;	/* 回调次数 */
+static uint64_t mistimed;	/* 未在预期滴答发生的回调次数 */
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void bench_callback(void *arg)
+{
+	slot_t *slot = arg;
+	callbacks++;
+	if (bench_ticks != slot->expected)
+		mistimed++;
+	slot->expected = bench_ticks + slot->interval;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-n timers] [-t ticks] [-i max_interval] [-s seed]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t count = DEFAULT_TIMERS;
+	uint64_t ticks = DEFAULT_TICKS;
+	uint64_t max_interval = DEFAULT_MAX_INTERVAL;
+	uint32_t seed = DEFAULT_SEED;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:t:i:s:h")) != -1) {
+		switch (opt) {
+			case 'n': count = strtoul(optarg, NULL, 0); break;
+			case 't': ticks = strtoull(optarg, NULL, 0); break;
+			case 'i': max_interval = strtoull(optarg, NULL, 0); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			default: usage(argv[0]);
+		}
+	}
+	if (optind != argc || !count || !max_interval) usage(argv[0]);
+
+	size_t pool_size = (size_t) POOL_MIB << 20;
+	void *pool = aligned_alloc(SLAB_SIZE, pool_size);
+	slots = calloc(count, sizeof(slot_t));
+	if (!pool || !slots) {
+		perror("alloc");
+		return 1;
+	}
+	memory_init(&g_mp, pool, pool_size);
+	kmem_init();
+	srand(seed);
+
+	/* 创建并启动全部定时器 */
+	for (uint32_t i = 0; i < count; i++) {
+		slots[i].timer = timer_create(bench_callback, &slots[i], 0);
+		if (!slots[i].timer) {
+			fprintf(stderr, "timer_create failed at %u\n", i);
+			return 1;
+		}
+	}
+
+	uint64_t start = now_ns();
+	for (uint32_t i = 0; i < count; i++) {
+		slots[i].interval = 1 + (uint64_t) rand() * rand() % max_interval;
+		slots[i].expected = bench_ticks + slots[i].interval;
+		timer_start(slots[i].timer, slots[i].interval, -1);
+	}
+	uint64_t start_ns = now_ns() - start;
+
+	/* 逐个滴答处理 */
+	uint64_t tick_max = 0;
+	start = now_ns();
+	for (uint64_t t = 0; t < ticks; t++) {
+		uint64_t begin = now_ns();
+		bench_ticks++;
+		timer_process();
+		uint64_t elapsed = now_ns() - begin;
+		if (elapsed > tick_max) tick_max = elapsed;
+	}
+	uint64_t tick_ns = now_ns() - start;
+
+	/* 随机停止并重新启动 */
+	start = now_ns();
+	for (uint32_t i = 0; i < RESTART_OPS; i++) {
+		slot_t *slot = &slots[rand() % count];
+		timer_stop(slot->timer);
+		slot->expected = bench_ticks + slot->interval;
+		timer_start(slot->timer, slot->interval, -1);
+	}
+	uint64_t restart_ns = now_ns() - start;
+
+	/* 查询最近的到期时刻，供无滴答空闲使用 */
+	uint64_t expiry = 0;
+	start = now_ns();
+	for (uint32_t i = 0; i < NEXT_EXPIRY_CALLS; i++)
+		expiry += timer_next_expiry();
+	uint64_t next_ns = now_ns() - start;
+
+	/* 再运行一段时间，核对重新启动后的定时器 */
+	for (uint64_t t = 0; t < max_interval; t++) {
+		bench_ticks++;
+		timer_process();
+	}
+
+	printf("timers      %u armed, intervals 1..%llu ticks, %llu ticks simulated\n",
+		timer_get_active_count(), (unsigned long long) max_interval, (unsigned long long) ticks);
+	printf("start       %.1f ns/op\n", (double) start_ns / count);
+	printf("tick        avg %.1f ns, max %llu ns\n", (double) tick_ns / ticks, (unsigned long long) tick_max);
+	printf("restart     %.1f ns/op (stop + start)\n", (double) restart_ns / RESTART_OPS);
+	printf("next        %.1f ns/op (timer_next_expiry)\n", (double) next_ns / NEXT_EXPIRY_CALLS);
+	printf("callbacks   %llu, %llu mistimed\n", (unsigned long long) callbacks, (unsigned long long) mistimed);
+	return mistimed ? 1 : 0;
+}
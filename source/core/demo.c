@@ -4,6 +4,7 @@
 
 #include <ClassiX/assets.h>
 #include <ClassiX/blkdev.h>
+#include <ClassiX/compositor.h>
 #include <ClassiX/cpu.h>
 #include <ClassiX/debug.h>
 #include <ClassiX/fatfs.h>
@@ -16,6 +17,7 @@
 #include <ClassiX/layer.h>
 #include <ClassiX/memory.h>
 #include <ClassiX/mouse.h>
+#include <ClassiX/page.h>
 #include <ClassiX/palette.h>
 #include <ClassiX/pci.h>
 #include <ClassiX/pit.h>
@@ -25,6 +27,7 @@
 #include <ClassiX/timer.h>
 #include <ClassiX/typedef.h>
 #include <ClassiX/window.h>
+#include <ClassiX/workqueue.h>
 
 #include <ctype.h>
 #include <stdarg.h>
@@ -184,11 +187,16 @@ static void terminal_cmd_help(TERMINAL *terminal)
 {
 	terminal_printf(terminal, "  cat      - Display file content\n");
 	terminal_printf(terminal, "  clear    - Clear screen\n");
+	terminal_printf(terminal, "  ctxbench - Measure task switch latency\n");
 	terminal_printf(terminal, "  echo     - Echo arguments\n");
 	terminal_printf(terminal, "  help     - Show this help\n");
+	terminal_printf(terminal, "  kthbench - Measure kernel thread create and exit cost\n");
 	terminal_printf(terminal, "  ls       - List directory contents\n");
+	terminal_printf(terminal, "  meminfo  - Display heap statistics\n");
+	terminal_printf(terminal, "  rtbench  - Measure periodic wake-up jitter under load\n");
 	terminal_printf(terminal, "  sysinfo  - Display system information\n");
 	terminal_printf(terminal, "  time     - Show current time\n");
+	terminal_printf(terminal, "  top      - Show tasks by CPU usage\n");
 }
 
 /* clear 命令 */
@@ -366,7 +374,7 @@ static void terminal_cmd_sysinfo(TERMINAL *terminal)
 
 		/* 检查 TSC 支持 */
 		if (check_tsc_support()) {
-			terminal_printf(terminal, "  TSC: Supported");
+			terminal_printf(terminal, "  TSC: Supported, %u.%03u MHz", tsc_khz / 1000, tsc_khz % 1000);
 
 			/* 检查 TSC 不变性 */
 			if (check_tsc_invariant())
@@ -436,6 +444,355 @@ static void terminal_cmd_sysinfo(TERMINAL *terminal)
 	terminal_printf(terminal, "  Used Memory: %u MiB\n", used_memory / (1024 * 1024));
 	terminal_printf(terminal, "  Free Memory: %u MiB\n", free_memory / (1024 * 1024));
 	terminal_printf(terminal, "  Usage: %.1f%%\n", usage_percent);
+
+	terminal_printf(terminal, "\n");
+
+	/* 任务切换信息 */
+	terminal_printf(terminal, "Task Switching:\n");
+	terminal_printf(terminal, "  Switches: %u\n", g_task_stats.switches);
+	terminal_printf(terminal, "  FPU Traps: %u, Swaps: %u\n", g_task_stats.fpu_traps, g_task_stats.fpu_swaps);
+	terminal_printf(terminal, "  Switches without FPU Save/Restore: %u\n", g_task_stats.switches - g_task_stats.fpu_swaps);
+	terminal_printf(terminal, "  Timed Sleeps: %u, Ticks Yielded: %llu\n", g_task_stats.timed_sleeps, g_task_stats.slept_ticks);
+	terminal_printf(terminal, "  Kernel Threads: %u created, %u reaped, %u stacks reused\n",
+		g_task_stats.kthreads_created, g_task_stats.kthreads_reaped, g_task_stats.kstacks_reused);
+	terminal_printf(terminal, "  Task Objects: %u (%u KiB)\n", g_task_stats.task_objects, g_task_stats.task_objects * sizeof(TASK) / 1024);
+	terminal_printf(terminal, "  Real-time Budget Exhaustions: %u\n", g_task_stats.rt_throttles);
+
+	terminal_printf(terminal, "\n");
+
+	/* 时钟中断信息 */
+	uint64_t ticks = get_system_ticks();
+	terminal_printf(terminal, "Timer Interrupts:\n");
+	terminal_printf(terminal, "  Interrupts: %llu in %llu ticks\n", pit_stats.interrupts, ticks);
+	terminal_printf(terminal, "  Tickless Sleeps: %u, Ticks Caught Up: %llu\n", pit_stats.tickless_entries, pit_stats.ticks_skipped);
+	if (tsc_khz)
+		terminal_printf(terminal, "  Max IRQ to EOI: %llu ns, Max Interrupts Off: %llu ns\n",
+			(uint64_t) pit_stats.eoi_cycles_max * 1000000 / tsc_khz,
+			(uint64_t) pit_stats.irq_off_cycles_max * 1000000 / tsc_khz);
+	terminal_printf(terminal, "  Deferred Work: %u queued, %u run, %u coalesced\n",
+		g_workqueue_stats.queued, g_workqueue_stats.executed, g_workqueue_stats.coalesced);
+
+	terminal_printf(terminal, "\n");
+
+	/* 合成信息 */
+	const COMPOSITOR_STATS *cs = &g_compositor_stats;
+	terminal_printf(terminal, "Compositor:\n");
+	terminal_printf(terminal, "  Frames: %u, Requests: %u (%u moves coalesced), Queue Stalls: %u\n",
+		cs->frames, cs->requests, cs->coalesced, cs->stalls);
+	if (tsc_khz && cs->frames)
+		terminal_printf(terminal, "  Input to Frame: avg %llu us, max %llu us\n",
+			cs->latency_total * 1000 / tsc_khz / cs->frames, (uint64_t) cs->latency_max * 1000 / tsc_khz);
+}
+
+/* meminfo 命令 */
+static void terminal_cmd_meminfo(TERMINAL *terminal)
+{
+	MEMORY_INFO info;
+	memory_get_info(&g_mp, &info);
+
+	const MEMORY_STATS *stats = &info.stats;
+
+	terminal_printf(terminal, "Kernel Heap:\n");
+	terminal_printf(terminal, "  Size: %u KiB\n", info.total_size / 1024);
+	terminal_printf(terminal, "  In Use: %u KiB (peak %u KiB)\n", stats->bytes_in_use / 1024, stats->peak_bytes / 1024);
+	terminal_printf(terminal, "  Free: %u KiB in %u blocks, largest %u KiB\n",
+		info.free_bytes / 1024, info.free_blocks, info.largest_free / 1024);
+	terminal_printf(terminal, "  Allocs: %u, Frees: %u, Failures: %u\n", stats->alloc_count, stats->free_count, stats->fail_count);
+	terminal_printf(terminal, "  krealloc: %u in place, %u moved\n", stats->realloc_inplace, stats->realloc_moved);
+	terminal_printf(terminal, "  Deferred Frees: %u (%u overflowed)\n", stats->deferred_frees, stats->defer_overflows);
+	terminal_printf(terminal, "  Longest IRQ-off: %llu cycles (lock), %llu cycles (kfree)\n", stats->irqoff_max, stats->irq_free_max);
+	terminal_printf(terminal, "  Pre-zeroed: %u hits, %u misses, %u KiB cached\n", stats->zero_hits, stats->zero_misses, (uint32_t) (stats->zeroed_bytes / 1024));
+
+	terminal_printf(terminal, "Free Block Sizes:\n");
+	for (int32_t i = 0; i < MEMORY_HIST_BUCKETS; i++)
+		if (info.histogram[i])
+			terminal_printf(terminal, "  >= %8u B: %u\n", i ? 1u << (i + MEMORY_HIST_MIN_SHIFT) : 0, info.histogram[i]);
+
+	terminal_printf(terminal, "Pages: %u free of %u\n", page_get_free_count(), page_get_total_count());
+
+	terminal_printf(terminal, "Tasks:\n");
+	for (TASK *task = task_iterate(NULL); task; task = task_iterate(task))
+		terminal_printf(terminal, "  %4d %10u B\n", TID(task), task->mem_bytes);
+
+	/* 同时输出到串口 */
+	memory_dump_info(&g_mp);
+}
+
+#define CTXBENCH_ROUNDS		(10000)
+
+static TASK *ctxbench_caller;	/* 发起测试的任务 */
+static TASK *ctxbench_peer;		/* 与之往返切换的任务，首次测试时创建并一直保留 */
+
+/* 往返切换任务：唤醒发起者后立即休眠 */
+static void __attribute__((noreturn)) ctxbench_peer_entry(void *arg)
+{
+	TASK *task = task_get_current();
+
+	cli();
+	for (;;) {
+		task_register(ctxbench_caller, ctxbench_caller->priority);
+		task_sleep(task);
+	}
+}
+
+/* ctxbench 命令 */
+static void terminal_cmd_ctxbench(TERMINAL *terminal)
+{
+	TASK *task = task_get_current();
+	ctxbench_caller = task;
+
+	if (!ctxbench_peer) {
+		ctxbench_peer = kthread_create(ctxbench_peer_entry, NULL, task->priority);
+		if (!ctxbench_peer) {
+			terminal_printf(terminal, "No free task.\n");
+			return;
+		}
+	}
+
+	/* 关中断进行，两个任务之间只经由 task_register 与 task_sleep 切换 */
+	cli();
+	uint64_t start = rdtsc();
+	uint64_t start_ns = get_system_nanoseconds();
+	for (int32_t i = 0; i < CTXBENCH_ROUNDS; i++) {
+		task_register(ctxbench_peer, task->priority);
+		task_sleep(task);
+	}
+	uint64_t cycles = rdtsc() - start;
+	uint64_t ns = get_system_nanoseconds() - start_ns;
+	sti();
+
+	terminal_printf(terminal, "%u round trips, %u cycles (%u ns) per switch\n",
+		CTXBENCH_ROUNDS, (uint32_t) (cycles / (2 * CTXBENCH_ROUNDS)), (uint32_t) (ns / (2 * CTXBENCH_ROUNDS)));
+	debug("CTXBENCH: %llu cycles for %u round trips.\n", cycles, CTXBENCH_ROUNDS);
+}
+
+#define KTHBENCH_ROUNDS		(1000)
+
+/* 立即返回的内核线程，返回即退出 */
+static void kthbench_entry(void *arg)
+{
+	(*(volatile uint32_t *) arg)++;
+}
+
+/* kthbench 命令 */
+static void terminal_cmd_kthbench(TERMINAL *terminal)
+{
+	volatile uint32_t ran = 0;
+	uint32_t reused = g_task_stats.kstacks_reused;
+
+	/* 新线程优先级更高，创建后立即运行并退出；下一次创建时回收它并复用其栈 */
+	uint64_t start = rdtsc();
+	for (int32_t i = 0; i < KTHBENCH_ROUNDS; i++)
+		if (!kthread_create(kthbench_entry, (void *) &ran, PRIORITY_HIGH))
+			break;
+	uint64_t cycles = rdtsc() - start;
+	kthread_reap();
+
+	terminal_printf(terminal, "%u threads ran, %u cycles per create/run/exit, %u stacks reused\n",
+		ran, ran ? (uint32_t) (cycles / ran) : 0, g_task_stats.kstacks_reused - reused);
+}
+
+#define TOP_MAX_TASKS		(32)
+#define TOP_MAX_ROWS		(12)
+#define TOP_INTERVAL_MS		(1000)
+
+/* top 命令在一次采样中记录的任务信息 */
+typedef struct {
+	TASK *task;
+	int32_t id;
+	TASK_PRIORITY priority;
+	bool realtime;
+	bool runnable;
+	uint64_t cycles;			/* 累计运行的 TSC 周期数 */
+	uint64_t delta;				/* 相对上一次采样增加的周期数 */
+	uint32_t voluntary;
+	uint32_t involuntary;
+	uint32_t latency_max;
+} TOP_ENTRY;
+
+/* 采样全部任务的运行周期数，并按相对上一次采样的增量降序排列 */
+static uint32_t top_sample(TOP_ENTRY *entries, const TOP_ENTRY *prev, uint32_t prev_count)
+{
+	uint32_t count = 0;
+	for (TASK *task = task_iterate(NULL); task && count < TOP_MAX_TASKS; task = task_iterate(task)) {
+		TOP_ENTRY entry = {
+			.task = task,
+			.id = TID(task),
+			.priority = task->priority,
+			.realtime = task->rt_period != 0,
+			.runnable = task->state == TASK_RUNNING,
+			.cycles = task_get_run_cycles(task),
+			.voluntary = task->voluntary_switches,
+			.involuntary = task->involuntary_switches,
+			.latency_max = task->wake_latency_max
+		};
+
+		/* 新任务或复用的任务对象从 0 开始计算增量 */
+		entry.delta = entry.cycles;
+		for (uint32_t i = 0; i < prev_count; i++)
+			if (prev[i].task == task && prev[i].cycles <= entry.cycles)
+				entry.delta = entry.cycles - prev[i].cycles;
+
+		/* 插入排序 */
+		uint32_t pos = count++;
+		while (pos > 0 && entries[pos - 1].delta < entry.delta) {
+			entries[pos] = entries[pos - 1];
+			pos--;
+		}
+		entries[pos] = entry;
+	}
+	return count;
+}
+
+/* top 命令 */
+static void terminal_cmd_top(TERMINAL *terminal)
+{
+	if (!tsc_khz) {
+		terminal_printf(terminal, "TSC not supported.\n");
+		return;
+	}
+
+	TASK *task = task_get_current();
+	TOP_ENTRY entries[2][TOP_MAX_TASKS];
+	uint32_t counts[2] = { 0, 0 };
+	uint32_t cur = 0;
+	uint64_t last = rdtsc();
+
+	counts[cur] = top_sample(entries[cur], NULL, 0);
+
+	/* 每秒刷新一次，按任意键退出 */
+	for (;;) {
+		task_sleep_ms(TOP_INTERVAL_MS);
+
+		bool quit = false;
+		EVENT event;
+		while (fifo_pop_event(&task->fifo, &event) == 0)
+			if (event.id == EVENT_KEYBOARD_KEYPRESS)
+				quit = true;
+		if (quit)
+			break;
+
+		uint64_t now = rdtsc();
+		uint64_t elapsed = now - last;
+		last = now;
+		counts[cur ^ 1] = top_sample(entries[cur ^ 1], entries[cur], counts[cur]);
+		cur ^= 1;
+
+		terminal_cmd_clear(terminal);
+		terminal_printf(terminal, "%u tasks, %u switches. Press any key to quit.\n", counts[cur], g_task_stats.switches);
+		terminal_printf(terminal, "   ID PRI S   CPU%%   TIME(ms)    VOL  INVOL  MAXWAKE(us)\n");
+		for (uint32_t i = 0; i < counts[cur] && i < TOP_MAX_ROWS; i++) {
+			const TOP_ENTRY *entry = &entries[cur][i];
+			uint32_t permille = elapsed ? (uint32_t) (entry->delta * 1000 / elapsed) : 0;
+			char priority[4];
+			if (entry->realtime)
+				strcpy(priority, "RT");
+			else
+				snprintf(priority, sizeof(priority), "%d", entry->priority);
+			terminal_printf(terminal, " %4d %3s %c %3u.%u %10u %6u %6u %12u\n",
+				entry->id, priority, entry->runnable ? 'R' : 'S', permille / 10, permille % 10,
+				(uint32_t) (entry->cycles / tsc_khz), entry->voluntary, entry->involuntary,
+				entry->latency_max / ((tsc_khz + 500) / 1000));
+		}
+
+		/* 唤醒延迟直方图，第 i 桶为 [2^(i-1), 2^i) 微秒 */
+		terminal_printf(terminal, "Wake-up latency (us):\n");
+		for (int32_t i = 0; i < TASK_LATENCY_BUCKETS; i++) {
+			char label[8];
+			if (i == 0)
+				strcpy(label, "<1");
+			else
+				snprintf(label, sizeof(label), "%u+", 1u << (i - 1));
+			terminal_printf(terminal, " %5s:%-5u", label, g_task_stats.wake_latency[i]);
+			if (i % 6 == 5)
+				terminal_printf(terminal, "\n");
+		}
+	}
+}
+
+#define RTBENCH_HOGS		(3)
+#define RTBENCH_ROUNDS		(500)
+#define RTBENCH_PERIOD_MS	(2)
+
+typedef struct {
+	bool realtime;				/* 是否以实时任务运行 */
+	uint64_t max_ns;			/* 唤醒间隔与周期之差的最大值 */
+	uint64_t total_ns;			/* 唤醒间隔与周期之差的总和 */
+	volatile bool done;
+} RTBENCH_RESULT;
+
+static volatile uint32_t rtbench_generation;	/* 每轮测试递增，上一轮的负载线程见到变化即退出 */
+
+/* 占用处理器的线程，模拟应用程序负载 */
+static void rtbench_hog_entry(void *arg)
+{
+	while (rtbench_generation == (uint32_t) arg)
+		pause();
+}
+
+/* 周期性线程：每 RTBENCH_PERIOD_MS 毫秒醒来一次，记录实际唤醒间隔偏离周期的程度 */
+static void rtbench_periodic_entry(void *arg)
+{
+	RTBENCH_RESULT *result = arg;
+	uint32_t period = RTBENCH_PERIOD_MS * pit_frequency / 1000;
+	uint64_t period_ns = (uint64_t) period * 1000000000 / pit_frequency;
+
+	if (result->realtime && task_set_realtime(task_get_current(), 1, 200) != 0)
+		result->realtime = false;
+
+	uint64_t tick = get_system_ticks() + 1;
+	task_sleep_until(tick);
+	uint64_t last = get_system_nanoseconds();
+	for (int32_t i = 0; i < RTBENCH_ROUNDS; i++) {
+		tick += period;
+		task_sleep_until(tick);
+		uint64_t now = get_system_nanoseconds();
+		uint64_t interval = now - last;
+		uint64_t jitter = interval > period_ns ? interval - period_ns : period_ns - interval;
+		last = now;
+
+		if (jitter > result->max_ns)
+			result->max_ns = jitter;
+		result->total_ns += jitter;
+	}
+
+	task_set_realtime(task_get_current(), 0, 0);
+	result->done = true;
+}
+
+/* rtbench 命令 */
+static void terminal_cmd_rtbench(TERMINAL *terminal)
+{
+	terminal_printf(terminal, "%u-ms period, %u rounds, %u busy threads at normal priority:\n",
+		RTBENCH_PERIOD_MS, RTBENCH_ROUNDS, RTBENCH_HOGS);
+
+	/* 先以普通优先级、再以实时任务运行周期性线程，比较两者的唤醒抖动 */
+	for (int32_t pass = 0; pass < 2; pass++) {
+		RTBENCH_RESULT result = { .realtime = pass == 1 };
+
+		uint32_t generation = ++rtbench_generation;
+		int32_t hogs = 0;
+		for (; hogs < RTBENCH_HOGS; hogs++)
+			if (!kthread_create(rtbench_hog_entry, (void *) generation, PRIORITY_NORMAL))
+				break;
+
+		if (!kthread_create(rtbench_periodic_entry, &result, PRIORITY_NORMAL)) {
+			rtbench_generation++;
+			terminal_printf(terminal, "No free task.\n");
+			return;
+		}
+		while (!result.done)
+			task_sleep_ms(100);
+		rtbench_generation++;
+
+		terminal_printf(terminal, "  %-9s avg jitter %6u us, max %6u us\n",
+			result.realtime ? "Real-time" : "Normal",
+			(uint32_t) (result.total_ns / RTBENCH_ROUNDS / 1000), (uint32_t) (result.max_ns / 1000));
+		debug("RTBENCH: %s with %d hogs, max jitter %llu ns.\n", result.realtime ? "real-time" : "normal", hogs, result.max_ns);
+	}
+
+	if (!tsc_khz)
+		terminal_printf(terminal, "TSC not supported, jitter measured in whole ticks.\n");
 }
 
 /* unknown 命令 */
@@ -471,6 +828,16 @@ static void terminal_process_cmdline(TERMINAL *terminal)
 		terminal_cmd_ls(terminal);
 	else if (strcmp(argv[0], "sysinfo") == 0)
 		terminal_cmd_sysinfo(terminal);
+	else if (strcmp(argv[0], "meminfo") == 0)
+		terminal_cmd_meminfo(terminal);
+	else if (strcmp(argv[0], "ctxbench") == 0)
+		terminal_cmd_ctxbench(terminal);
+	else if (strcmp(argv[0], "kthbench") == 0)
+		terminal_cmd_kthbench(terminal);
+	else if (strcmp(argv[0], "top") == 0)
+		terminal_cmd_top(terminal);
+	else if (strcmp(argv[0], "rtbench") == 0)
+		terminal_cmd_rtbench(terminal);
 	else {
 		int32_t result = program_exec(argc, argv);
 		if (result == SRV_NOT_FOUND)
@@ -484,7 +851,7 @@ static void terminal_process_cmdline(TERMINAL *terminal)
 	terminal_printf(terminal, "\n");
 }
 
-void __attribute__((noreturn)) task_terminal_entry(void)
+void __attribute__((noreturn)) task_terminal_entry(void *arg)
 {
 	TASK *task = task_get_current();
 	TERMINAL terminal;
@@ -512,7 +879,7 @@ void __attribute__((noreturn)) task_terminal_entry(void)
 		cli();
 		if (fifo_status(&task->fifo) == 0) {
 			sti();
-			task_sleep(task);
+			fifo_wait(&task->fifo, 3);
 		} else {
 			EVENT event;
 			fifo_pop_event(&task->fifo, &event);
@@ -591,17 +958,10 @@ void __attribute__((noreturn)) task_terminal_entry(void)
 
 TASK *demo_terminal(void)
 {
-	TASK *task_terminal = task_alloc();
-	task_terminal->tss.esp = (uint32_t) memory_alloc_irqsave(&g_mp, DEFAULT_USER_STACK, task_terminal) + DEFAULT_USER_STACK;
-	task_terminal->tss.eip = (uint32_t) &task_terminal_entry;
-	task_terminal->tss.es = 0x10;
-	task_terminal->tss.cs = 0x08;
-	task_terminal->tss.ss = 0x10;
-	task_terminal->tss.ds = 0x10;
-	task_terminal->tss.fs = 0x10;
-	task_terminal->tss.gs = 0x10;
-	task_register(task_terminal, PRIORITY_NORMAL);
-	fifo_init(&task_terminal->fifo, 128, memory_alloc_irqsave(&g_mp, 128 * sizeof(uint32_t), task_terminal), task_terminal);
+	TASK *task_terminal = kthread_create(task_terminal_entry, NULL, PRIORITY_NORMAL);
+	if (!task_terminal)
+		return NULL;
+	fifo_init(&task_terminal->fifo, 128, memory_alloc_irqsave(&g_mp, 128 * sizeof(uint32_t), task_terminal));
 	return task_terminal;
 }
 
@@ -60,21 +60,22 @@ void isr_ud(ISR_PARAMS *params)
 	print_exception_info("Invalid Opcode", params);
 }
 
-/* 设备不可用异常 */
+/* 设备不可用异常：切换到未持有 FPU 的任务后首次使用 FPU 时触发 */
 void isr_nm(ISR_PARAMS *params)
 {
-	static const TASK * fpu_owner = NULL;
 	TASK *current = task_get_current();
 
 	/* 清除 CR0.TS 位 */
 	asm volatile ("clts");
 
-	if (fpu_owner == current)
+	g_task_stats.fpu_traps++;
+	if (g_fpu_owner == current)
 		return;
 
-	/* 保存当前的 FPU 状态 */
-	if (fpu_owner)
-		asm volatile ("fxsave %0":"=m"(*(uint8_t*) fpu_owner->fpu_state)::"memory");
+	/* 保存上一个持有者的 FPU 状态 */
+	g_task_stats.fpu_swaps++;
+	if (g_fpu_owner)
+		asm volatile ("fxsave %0":"=m"(*(uint8_t*) g_fpu_owner->fpu_state)::"memory");
 
 	if (current->fpu_used) {
 		/* 恢复 FPU 的状态 */
@@ -86,7 +87,7 @@ void isr_nm(ISR_PARAMS *params)
 		current->fpu_used = true;
 	}
 
-	fpu_owner = current;
+	g_fpu_owner = current;
 }
 
 /* 双重故障异常 */
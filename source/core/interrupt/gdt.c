@@ -24,6 +24,8 @@ typedef struct __attribute__((packed)) {
 	0 - 保留
 	1 - 内核代码段
 	2 - 内核数据段
+	3 - 运行应用程序的任务的 LDT（任务切换时改写）
+	4 - TSS
 */
 static gdt_entry_t gdt_entries[GDT_LIMIT];
 static gdt_ptr_t gdt_ptr;
@@ -5,6 +5,7 @@
 #include <ClassiX/assets.h>
 #include <ClassiX/blkdev.h>
 #include <ClassiX/buzzer.h>
+#include <ClassiX/compositor.h>
 #include <ClassiX/cpu.h>
 #include <ClassiX/debug.h>
 #include <ClassiX/fatfs.h>
@@ -19,14 +20,17 @@
 #include <ClassiX/memory.h>
 #include <ClassiX/mouse.h>
 #include <ClassiX/multiboot.h>
+#include <ClassiX/page.h>
 #include <ClassiX/palette.h>
 #include <ClassiX/pci.h>
 #include <ClassiX/pit.h>
 #include <ClassiX/rtc.h>
+#include <ClassiX/slab.h>
 #include <ClassiX/task.h>
 #include <ClassiX/timer.h>
 #include <ClassiX/typedef.h>
 #include <ClassiX/window.h>
+#include <ClassiX/workqueue.h>
 
 #include <ctype.h>
 #include <string.h>
@@ -49,6 +53,8 @@
 #define DBLCLK_THRESHOLD_MS					(500)	/* 双击最大时间间隔（毫秒） */
 #define DBLCLK_THRESHOLD_DIST 				(4)		/* 双击最大移动距离（像素）) */
 
+#define KERNEL_HEAP_MIN_SIZE				(4 * 1024 * 1024)	/* 内核内存池的最小大小 */
+
 extern uintptr_t kernel_start_phys;					/* 内核起始物理地址 */
 extern uintptr_t kernel_end_phys;					/* 内核结束物理地址 */
 extern uintptr_t bss_start_phys;					/* BSS 段起始地址 */
@@ -134,10 +140,23 @@ void main(multiboot_info_t *mbi)
 	if (mbi->flags & MULTIBOOT_INFO_CMDLINE)
 		debug("Boot comand line: %s\n", (char *) mbi->cmdline);
 
-	/* 初始化内存管理 */
-	uintptr_t mem_start = (uintptr_t) &kernel_end_phys;
-	size_t mem_size = (size_t) (mbi->mem_upper * 1024 - ((uintptr_t) &kernel_end_phys - (uintptr_t) &kernel_start_phys));
-	memory_init(&g_mp, (void*) mem_start, mem_size);
+	/* 初始化页分配器，覆盖内存映射中全部可用区域 */
+	page_init(mbi, (uintptr_t) &kernel_end_phys);
+
+	/* 内核内存池建立于页分配器之上，取约一半可用内存，其余留给大缓冲区 */
+	size_t heap_size = page_get_free_count() / 2 * PAGE_SIZE;
+	if (heap_size > ((size_t) PAGE_SIZE << PAGE_MAX_ORDER))
+		heap_size = (size_t) PAGE_SIZE << PAGE_MAX_ORDER;
+	void *heap = NULL;
+	for (; heap_size >= KERNEL_HEAP_MIN_SIZE; heap_size /= 2)
+		if ((heap = page_alloc_size(heap_size)))
+			break;
+	if (!heap) {
+		debug("Failed to allocate kernel heap.\n");
+		while (true) hlt();
+	}
+	memory_init(&g_mp, heap, heap_size);
+	kmem_init();
 
 	/* 初始化中断服务 */
 	init_gdt();
@@ -148,17 +167,26 @@ void main(multiboot_info_t *mbi)
 	init_fpu();
 
 	/* 初始化键盘、鼠标 */
-	fifo_init(&kmsg, KMSG_QUEUE_SIZE, kmsg_queue_buf, NULL);
+	fifo_init(&kmsg, KMSG_QUEUE_SIZE, kmsg_queue_buf);
 	init_keyboard(&kmsg, KEYBOARD_DATA0);
 	init_mouse(&kmsg, MOUSE_DATA0);
 
 	/* 初始化多任务 */
 	TASK *ktask = init_multitasking();
-	kmsg.task = ktask;
 	task_register(ktask, PRIORITY_HIGH);
 
+	/* 初始化工作队列 */
+	init_workqueue();
+
 	/* 初始化 PIT */
 	init_pit(1000); /* 频率为 1000 Hz */
+
+	/* 内核任务此后负责输入分派，每 5 ms 保证 1 ms 处理器时间，先于合成任务处理输入 */
+	task_set_realtime(ktask, 5, 1000);
+
+	/* 初始化异步蜂鸣器 */
+	async_buzzer_init();
+
 	/* 初始化 PIC */
 	out8(PIC0_IMR,  0b11111000); /* 允许 IRQ0、IRQ1 和 IRQ2 */
 	out8(PIC1_IMR,  0b11101111); /* 允许 IRQ12 */
@@ -190,6 +218,9 @@ void main(multiboot_info_t *mbi)
 	layer_move(layer_cursor, cursor_x, cursor_y);
 	layer_set_z(layer_cursor, 1);
 
+	/* 图层的移动与窗口的激活交由合成任务，本任务只解码输入、命中测试和分派事件 */
+	init_compositor();
+
 	int32_t drag_start_x = 0, drag_start_y = 0;					/* 拖动起始位置 */
 	int32_t drag_window_start_x = 0, drag_window_start_y = 0;	/* 拖动窗口起始位置 */
 	int32_t new_window_x = 0, new_window_y = 0;					/* 窗口移动后的位置 */
@@ -222,7 +253,7 @@ void main(multiboot_info_t *mbi)
 	uint32_t key_cmd_wait = 0xffffffff;		/* 键盘命令等待标志 */
 	FIFO key_cmd_queue;						/* 键盘命令 FIFO */
 	uint32_t key_cmd_buf[32] = { };			/* 键盘命令缓冲区 */
-	fifo_init(&key_cmd_queue, 32, key_cmd_buf, NULL);
+	fifo_init(&key_cmd_queue, 32, key_cmd_buf);
 	fifo_push(&key_cmd_queue, KEYCMD_LED);
 	fifo_push(&key_cmd_queue, 0); /* 初始状态全部关闭 */
 
@@ -239,16 +270,16 @@ void main(multiboot_info_t *mbi)
 		cli();
 		if (fifo_status(&kmsg) == 0) {
 			sti();
+			/* 已取完积压的输入，将最终的光标与窗口位置交给合成任务 */
 			if (cursor_updated) {
-				/* 光标位置已更新 */
-				layer_move(layer_cursor, new_cursor_x, new_cursor_y);
+				compositor_move(layer_cursor, new_cursor_x, new_cursor_y);
 				cursor_updated = false;
-			} else if (window_updated && layer_dragged) {
-				/* 窗口位置已更新 */
-				layer_move(layer_dragged, new_window_x, new_window_y);
-			} else {
-				task_sleep(ktask);
 			}
+			if (window_updated && layer_dragged) {
+				compositor_move(layer_dragged, new_window_x, new_window_y);
+				window_updated = false;
+			}
+			fifo_wait(&kmsg, 1);
 		} else {
 			uint32_t _data = fifo_pop(&kmsg);
 			sti();
@@ -267,7 +298,8 @@ void main(multiboot_info_t *mbi)
 
 				bool is_down = is_extended ? (expanded_key_phase == 1) : ((raw & 0x80) == 0);
 
-				/* 发送 KEYBOARD_KEYDOWN / KEYBOARD_KEYUP 事件 */
+				/* 发送 KEYBOARD_KEYDOWN / KEYBOARD_KEYUP 事件；持锁以免焦点窗口同时被销毁 */
+				layer_lock();
 				if (layer_focused && layer_focused->window && layer_focused->window->task) {
 					EVENT event = {
 						.window = layer_focused->window,
@@ -276,6 +308,7 @@ void main(multiboot_info_t *mbi)
 					};
 					fifo_push_event(&layer_focused->window->task->fifo, &event);
 				}
+				layer_unlock();
 
 				/* 将键码转换为字符数据 */
 				if (_data < KEYBOARD_DATA0 + 0x80)
@@ -307,6 +340,7 @@ void main(multiboot_info_t *mbi)
 							keychar = 0;
 
 				/* 发送 KEYPRESS 事件 */
+				layer_lock();
 				if (keychar && layer_focused && layer_focused->window && layer_focused->window->task) {
 					EVENT event = {
 						.window = layer_focused->window,
@@ -315,6 +349,7 @@ void main(multiboot_info_t *mbi)
 					};
 					fifo_push_event(&layer_focused->window->task->fifo, &event);
 				}
+				layer_unlock();
 
 				/* LControl */
 				if (_data == KEYBOARD_DATA0 + 0x1d)
@@ -460,7 +495,8 @@ void main(multiboot_info_t *mbi)
 						/* 即使光标移出窗口，事件依然发给该窗口 */
 						layer_target = layer_captured;
 					} else {
-						/* 从顶层向下查找窗口 */
+						/* 从顶层向下查找窗口；合成任务与应用程序可能同时调整 Z 序 */
+						layer_lock();
 						for (int32_t z = g_lm.top - 1; z > 0; z--) {
 							LAYER *current_layer = g_lm.layers[z];
 							if (!current_layer->window) continue;
@@ -478,6 +514,7 @@ void main(multiboot_info_t *mbi)
 								}
 							}
 						}
+						layer_unlock();
 					}
 
 					/* 相对于目标窗口的坐标 */
@@ -507,7 +544,7 @@ void main(multiboot_info_t *mbi)
 
 					/* 如果有任意键按下，且没有在系统拖拽/捕获中，尝试激活窗口 */
 					if (buttons_down && win_target && !dragging && !layer_captured) {
-						window_activate(win_target);
+						compositor_activate(win_target);
 						/* 进行命中测试 */
 						hit = window_hit_test(win_target, rx, ry);
 					} else if (win_target) {
@@ -625,10 +662,10 @@ void main(multiboot_info_t *mbi)
 							if (dragging) {
 								dragging = false;
 								if (layer_dragged && window_updated) {
-									layer_move(layer_dragged, new_window_x, new_window_y);
+									compositor_move(layer_dragged, new_window_x, new_window_y);
 									window_updated = false;
-									layer_dragged = NULL;
 								}
+								layer_dragged = NULL;
 							}
 						}
 					}
@@ -2,8 +2,13 @@
 	core/memory.c
 */
 
+#include <ClassiX/cpu.h>
 #include <ClassiX/debug.h>
+#include <ClassiX/io.h>
 #include <ClassiX/memory.h>
+#include <ClassiX/page.h>
+#include <ClassiX/pit.h>
+#include <ClassiX/slab.h>
 #include <ClassiX/task.h>
 #include <ClassiX/typedef.h>
 
@@ -17,22 +22,454 @@ typedef struct __attribute__((aligned(16))) {
 	uint32_t magic;
 	size_t size;		/* 包括头尾 */
 	uint8_t state;
+	uint8_t tracked;	/* 是否属于分配域，是则块尾有 block_trailer_t */
 	TASK *task;			/* 使用此内存块的任务 */
 } block_header_t;
 
-typedef struct __attribute__((aligned(16))) {
+typedef struct {
 	size_t size;		/* 必须与 header 中 size 一致 */
 } block_footer_t;
 
+/* 分配域记录：仅属于分配域的内存块在块尾（footer 之前）保留，其余内存块不承担此开销 */
+typedef struct {
+	MEMORY_ARENA *arena;	/* 所属分配域 */
+	MEMORY_LINK link;	/* 分配域内的内存块链表 */
+} block_trailer_t;
+
 typedef struct freeblock_t {
 	struct freeblock_t *prev;
 	struct freeblock_t *next;
 } freeblock_t;
 
+#define LINK_TO_TRAILER(l)					((block_trailer_t *) ((uint8_t *) (l) - offsetof(block_trailer_t, link)))
+
 #define MIN_BLOCK_SIZE						(sizeof(block_header_t) + sizeof(block_footer_t) + sizeof(freeblock_t))
+#define BLOCK_ALIGNMENT						(16)		/* 内存块起始地址的最小对齐 */
+#define MIN_SPLIT_SIZE						ALIGN_UP(MIN_BLOCK_SIZE, ALLOC_ALIGNMENT)	/* 分割出的剩余块的最小大小 */
+#define MIN_LEAD_SIZE						ALIGN_UP(MIN_BLOCK_SIZE, BLOCK_ALIGNMENT)	/* 对齐分配时前部空闲块的最小大小 */
+
+/* 两级分离适配（TLSF）索引：一级按大小的最高位，二级将其线性划分为 MEMORY_SL_COUNT 份 */
+#define TLSF_ALIGN_SHIFT					(4)			/* 块大小的粒度为 2^4 字节 */
+#define TLSF_FL_SHIFT						(MEMORY_SL_LOG2 + TLSF_ALIGN_SHIFT)
+#define TLSF_SMALL_SIZE						(1u << TLSF_FL_SHIFT)	/* 小于此大小的块位于第 0 个一级类别 */
+#define TLSF_MAX_SIZE						(1u << (MEMORY_FL_COUNT + TLSF_FL_SHIFT - 2))	/* 可查找的最大块 */
+
+#define NODE_TO_HEADER(n)					((block_header_t *) ((uint8_t *) (n) - sizeof(block_header_t)))
+#define HEADER_TO_NODE(h)					((freeblock_t *) ((uint8_t *) (h) + sizeof(block_header_t)))
+
+static_assert(MEMORY_SL_COUNT <= 32, "second-level bitmap must fit in 32 bits");
+static_assert(MIN_BLOCK_SIZE >= (1u << TLSF_ALIGN_SHIFT), "block granularity too coarse for TLSF");
+static_assert(ALLOC_ALIGNMENT >= BLOCK_ALIGNMENT, "block sizes must keep headers aligned");
+static_assert(sizeof(block_header_t) % BLOCK_ALIGNMENT == 0, "data must start aligned after the header");
+
+#ifdef MEMORY_TRACE
+	#define memtrace(fmt, ...)				debug("MEMTRACE: " fmt, ##__VA_ARGS__)
+#else
+	#define memtrace(fmt, ...)				((void) 0)
+#endif
+
+#define DEFER_RING_SIZE						(256)		/* 延迟释放环的容量，须为 2 的幂 */
+
+#define ZERO_MIN_SHIFT						(12)		/* 最小的预清零类别为 4 KiB */
+#define ZERO_MAX_SHIFT						(19)		/* 最大的预清零类别为 512 KiB */
+#define ZERO_CLASSES						(ZERO_MAX_SHIFT - ZERO_MIN_SHIFT + 1)
+#define ZERO_MIN_SIZE						(1u << ZERO_MIN_SHIFT)	/* 更小的请求直接清零 */
+#define ZERO_MAX_SIZE						(1u << ZERO_MAX_SHIFT)
+#define ZERO_BUDGET							(512 * 1024)	/* 预清零内存块合计的上限（按类别大小计） */
+
+static_assert((DEFER_RING_SIZE & (DEFER_RING_SIZE - 1)) == 0, "`DEFER_RING_SIZE` must be a power of two");
+static_assert(ZERO_MAX_SIZE <= ZERO_BUDGET, "every zeroed class must fit in the budget");
 
 MEMORY_POOL g_mp;		/* 内核内存池 */
 
+/* 延迟释放环：关中断时的 kfree 在此排队，由普通上下文排空 */
+static void *defer_ring[DEFER_RING_SIZE];	/* 空槽位为 NULL */
+static uint32_t defer_head = 0;				/* 生产者预留的下一个位置 */
+static uint32_t defer_tail = 0;				/* 消费者的下一个位置 */
+static bool defer_draining = false;			/* 是否有调用者正在排空 */
+
+/* 预清零内存块：每个类别至多缓存一块，合计不超过 ZERO_BUDGET，由空闲任务为曾被请求过的类别补充 */
+static void *zero_blocks[ZERO_CLASSES];		/* 各类别的已清零内存块 */
+static uint32_t zero_wanted = 0;			/* 待补充的类别位图 */
+static size_t zero_cached = 0;				/* 已缓存类别的大小之和 */
+static spinlock_t zero_lock = SPINLOCK_INITIALIZER;
+
+/* 求块大小所属的类别 */
+static inline void mapping_insert(size_t size, uint32_t *fl, uint32_t *sl)
+{
+	if (size < TLSF_SMALL_SIZE) {
+		*fl = 0;
+		*sl = (uint32_t) size >> TLSF_ALIGN_SHIFT;
+	} else {
+		uint32_t f = 31 - __builtin_clz((uint32_t) size);
+		*sl = ((uint32_t) size >> (f - MEMORY_SL_LOG2)) ^ MEMORY_SL_COUNT;
+		*fl = f - TLSF_FL_SHIFT + 1;
+	}
+}
+
+/* 求查找时的起始类别：向上取整到类别边界，使该类别中的任意块都能满足请求 */
+static inline void mapping_search(size_t size, uint32_t *fl, uint32_t *sl)
+{
+	if (size >= TLSF_SMALL_SIZE)
+		size += (1u << (31 - __builtin_clz((uint32_t) size) - MEMORY_SL_LOG2)) - 1;
+	mapping_insert(size, fl, sl);
+}
+
+/* 从空闲索引中移除 */
+static inline void freelist_remove(MEMORY_POOL *pool, block_header_t *header)
+{
+	uint32_t fl, sl;
+	mapping_insert(header->size, &fl, &sl);
+
+	freeblock_t *node = HEADER_TO_NODE(header);
+	if (node->prev) node->prev->next = node->next;
+	if (node->next) node->next->prev = node->prev;
+	if (pool->free_lists[fl][sl] == node) {
+		pool->free_lists[fl][sl] = node->next;
+		if (!node->next) {
+			pool->sl_bitmap[fl] &= ~(1u << sl);
+			if (!pool->sl_bitmap[fl])
+				pool->fl_bitmap &= ~(1u << fl);
+		}
+	}
+}
+
+/* 插入空闲索引 */
+static inline void freelist_insert(MEMORY_POOL *pool, block_header_t *header)
+{
+	uint32_t fl, sl;
+	mapping_insert(header->size, &fl, &sl);
+
+	freeblock_t *node = HEADER_TO_NODE(header);
+	freeblock_t *head = pool->free_lists[fl][sl];
+	node->prev = NULL;
+	node->next = head;
+	if (head) head->prev = node;
+	pool->free_lists[fl][sl] = node;
+
+	pool->sl_bitmap[fl] |= 1u << sl;
+	pool->fl_bitmap |= 1u << fl;
+}
+
+/*
+	@brief 查找不小于指定大小的空闲块。
+	@param pool 待操作的内存池
+	@param size 块大小（包括头尾）
+	@return 空闲块头，无满足条件的块时返回 NULL
+	@note 仅需两次位图查找，耗时与空闲块数量无关。
+*/
+static block_header_t *freelist_find(MEMORY_POOL *pool, size_t size)
+{
+	if (size > TLSF_MAX_SIZE)
+		return NULL;
+
+	uint32_t fl, sl;
+	mapping_search(size, &fl, &sl);
+	if (fl >= MEMORY_FL_COUNT)
+		return NULL;
+
+	/* 先在同一一级类别中找更大的二级类别，再找更大的一级类别 */
+	uint32_t sl_map = pool->sl_bitmap[fl] & (~0u << sl);
+	if (!sl_map) {
+		uint32_t fl_map = pool->fl_bitmap & (~0u << (fl + 1));
+		if (!fl_map)
+			return NULL;
+		fl = __builtin_ctz(fl_map);
+		sl_map = pool->sl_bitmap[fl];
+	}
+	sl = __builtin_ctz(sl_map);
+
+	block_header_t *header = NODE_TO_HEADER(pool->free_lists[fl][sl]);
+	return header->magic == BLOCK_MAGIC ? header : NULL;
+}
+
+/* 遍历全部空闲块 */
+#define for_each_free_block(pool, fl, sl, node) \
+	for (fl = 0; fl < MEMORY_FL_COUNT; fl++) \
+		for (sl = 0; sl < MEMORY_SL_COUNT; sl++) \
+			for (node = (freeblock_t *) (pool)->free_lists[fl][sl]; node; node = node->next)
+
+/* 写入内存块头尾 */
+static inline block_header_t *block_init(void *addr, size_t size, uint8_t state, TASK *task)
+{
+	block_header_t *header = (block_header_t *) addr;
+	header->magic = BLOCK_MAGIC;
+	header->size = size;
+	header->state = state;
+	header->task = task;
+	header->tracked = false;
+
+	block_footer_t *footer = (block_footer_t *) ((uint8_t *) addr + size - sizeof(block_footer_t));
+	footer->size = size;
+	return header;
+}
+
+/* 求内存块的分配域记录，须已为其预留空间 */
+static inline block_trailer_t *block_trailer(block_header_t *header)
+{
+	return (block_trailer_t *) ((uint8_t *) header + header->size - sizeof(block_footer_t) - sizeof(block_trailer_t));
+}
+
+/* 由分配域记录求内存块头：记录之后紧接 footer */
+static inline block_header_t *trailer_to_header(block_trailer_t *trailer)
+{
+	block_footer_t *footer = (block_footer_t *) (trailer + 1);
+	return (block_header_t *) ((uint8_t *) footer + sizeof(block_footer_t) - footer->size);
+}
+
+/* 求已分配块所属的分配域 */
+static inline MEMORY_ARENA *block_arena(block_header_t *header)
+{
+	return header->tracked ? block_trailer(header)->arena : NULL;
+}
+
+/* 求已分配块的可用字节数 */
+static inline size_t block_capacity(block_header_t *header)
+{
+	return header->size - sizeof(block_header_t) - sizeof(block_footer_t)
+		- (header->tracked ? sizeof(block_trailer_t) : 0);
+}
+
+/* 将已分配块加入分配域，块尾须已预留 block_trailer_t */
+static inline void block_track(block_header_t *header, MEMORY_ARENA *arena)
+{
+	if (!arena) return;
+
+	block_trailer_t *trailer = block_trailer(header);
+	header->tracked = true;
+	trailer->arena = arena;
+
+	MEMORY_LINK *sentinel = &arena->blocks;
+	trailer->link.prev = sentinel->prev;
+	trailer->link.next = sentinel;
+	sentinel->prev->next = &trailer->link;
+	sentinel->prev = &trailer->link;
+
+	arena->bytes += header->size;
+	arena->count++;
+}
+
+/*
+	求新分配的内存块应归入的分配域。只有任务上下文中开中断时的 kmalloc 类分配才归入当前任务的分配域；
+	中断处理程序与定时器回调均在关中断时运行，其分配的内存块可能属于全局状态，不能随任务的分配域一起释放。
+*/
+static inline MEMORY_ARENA *arena_for(TASK *task)
+{
+	if (!task || !task->arena || !(load_eflags() & EFLAGS_IF))
+		return NULL;
+	return task->arena;
+}
+
+/* 求分配请求实际须从内存池申请的字节数：归入分配域的内存块另需块尾记录 */
+static inline size_t arena_request(size_t size, MEMORY_ARENA *arena)
+{
+	return arena ? size + sizeof(block_trailer_t) : size;
+}
+
+/* 将已分配块移出所属分配域 */
+static inline void block_untrack(block_header_t *header)
+{
+	if (!header->tracked) return;
+
+	block_trailer_t *trailer = block_trailer(header);
+	MEMORY_ARENA *arena = trailer->arena;
+	trailer->link.prev->next = trailer->link.next;
+	trailer->link.next->prev = trailer->link.prev;
+	header->tracked = false;
+
+	arena->bytes -= header->size;
+	arena->count--;
+}
+
+/* 求容纳指定数据的内存块大小：不小于 MIN_SPLIT_SIZE，以便释放后仍能容纳空闲链表节点 */
+static inline size_t block_size_for(size_t size)
+{
+	size_t total_size = ALIGN_UP(size + sizeof(block_header_t) + sizeof(block_footer_t), ALLOC_ALIGNMENT);
+	return total_size < MIN_SPLIT_SIZE ? MIN_SPLIT_SIZE : total_size;
+}
+
+/* 记录已分配字节数的变化 */
+static inline void stats_account(MEMORY_POOL *pool, TASK *task, ptrdiff_t delta)
+{
+	pool->stats.bytes_in_use += delta;
+	if (pool->stats.bytes_in_use > pool->stats.peak_bytes)
+		pool->stats.peak_bytes = pool->stats.bytes_in_use;
+	if (task)
+		task->mem_bytes += delta;
+}
+
+/* 获取内存池锁，并记录关中断区间的起点；不支持 TSC 时（tsc_khz 为 0）不计时 */
+static inline uint32_t pool_lock(MEMORY_POOL *pool)
+{
+	uint32_t eflags = spinlock_acquire_irqsave(&pool->lock);
+	pool->lock_tsc = tsc_khz ? rdtsc() : 0;
+	return eflags;
+}
+
+/* 释放内存池锁，并更新最长关中断区间 */
+static inline void pool_unlock(MEMORY_POOL *pool, uint32_t eflags)
+{
+	if (pool->lock_tsc) {
+		uint64_t cycles = rdtsc() - pool->lock_tsc;
+		if (cycles > pool->stats.irqoff_max)
+			pool->stats.irqoff_max = cycles;
+	}
+	spinlock_release_irqrestore(&pool->lock, eflags);
+}
+
+/*
+	@brief 从空闲块中切出已分配块。
+	@param pool 待操作的内存池
+	@param header 空闲块头
+	@param offset 已分配块相对空闲块起始的偏移，为 0 或不小于 `MIN_LEAD_SIZE`
+	@param total_size 已分配块大小（包括头尾）
+	@param task 使用此内存块的任务
+	@return 指向已分配块数据区的指针
+*/
+static void *block_carve(MEMORY_POOL *pool, block_header_t *header, size_t offset, size_t total_size, TASK *task)
+{
+	size_t remaining = header->size - offset - total_size;
+
+	freelist_remove(pool, header);
+	if (offset) {
+		/* 前部保留为空闲块 */
+		block_init(header, offset, BLOCK_FREE, NULL);
+		freelist_insert(pool, header);
+	}
+
+	if (remaining < MIN_SPLIT_SIZE) {
+		/* 剩余部分过小，整体分配 */
+		total_size += remaining;
+		remaining = 0;
+	}
+
+	block_header_t *used = block_init((uint8_t *) header + offset, total_size, BLOCK_USED, task);
+	pool->stats.alloc_count++;
+	stats_account(pool, task, (ptrdiff_t) total_size);
+
+	if (remaining) {
+		/* 分割，剩余部分作为新空闲块 */
+		block_header_t *rest = block_init((uint8_t *) used + total_size, remaining, BLOCK_FREE, NULL);
+		freelist_insert(pool, rest);
+	}
+
+	return (void *) ((uint8_t *) used + sizeof(block_header_t));
+}
+
+/*
+	@brief 将已标记为空闲的块与相邻空闲块合并，并加入空闲链表。
+	@param pool 待操作的内存池
+	@param header 空闲块头，尚未加入空闲链表
+*/
+static void block_coalesce(MEMORY_POOL *pool, block_header_t *header)
+{
+	/* 向后合并 */
+	block_header_t *next_header = (block_header_t *) ((uint8_t *) header + header->size);
+	if ((uint8_t *) next_header + sizeof(block_header_t) <= ((uint8_t *) pool->start + pool->size)
+		&& next_header->magic == BLOCK_MAGIC
+		&& next_header->state == BLOCK_FREE) {
+		/* 从空闲索引中移除下一个块后合并 */
+		freelist_remove(pool, next_header);
+		header->size += next_header->size;
+		block_footer_t *footer = (block_footer_t *) ((uint8_t *) header + header->size - sizeof(block_footer_t));
+		footer->size = header->size;
+	}
+
+	/* 向前合并 */
+	if ((uint8_t *) header > (uint8_t *) pool->start) {
+		block_footer_t *prev_footer = (block_footer_t *) ((uint8_t *) header - sizeof(block_footer_t));
+		block_header_t *prev_header = (block_header_t *) ((uint8_t *) header - prev_footer->size);
+
+		if (prev_header->magic == BLOCK_MAGIC && prev_header->state == BLOCK_FREE) {
+			/* 合并后大小改变，须按新大小重新加入索引 */
+			freelist_remove(pool, prev_header);
+			prev_header->size += header->size;
+			block_footer_t *footer =
+				(block_footer_t *) ((uint8_t *) prev_header + prev_header->size - sizeof(block_footer_t));
+			footer->size = prev_header->size;
+			header = prev_header;
+		}
+	}
+
+	/* 将当前块加入空闲索引 */
+	freelist_insert(pool, header);
+}
+
+/*
+	@brief 原地调整已分配块的大小。
+	@param pool 待操作的内存池
+	@param header 已分配块头
+	@param total_size 新的块大小（包括头尾，已对齐）
+	@return 成功返回 true；后继块不是空闲块或空间不足时返回 false
+	@note 缩小时若剩余部分足够大则切出并归还；扩大时吸收相邻的后继空闲块。
+		  不处理分配域记录，由 block_resize 负责。
+*/
+static bool block_resize_untracked(MEMORY_POOL *pool, block_header_t *header, size_t total_size)
+{
+	size_t old_total = header->size;
+
+	if (total_size <= old_total) {
+		/* 缩小：剩余部分过小时保持原样 */
+		size_t remaining = old_total - total_size;
+		if (remaining < MIN_SPLIT_SIZE)
+			return true;
+
+		header->size = total_size;
+		((block_footer_t *) ((uint8_t *) header + total_size - sizeof(block_footer_t)))->size = total_size;
+		stats_account(pool, header->task, -(ptrdiff_t) remaining);
+
+		/* 剩余部分作为空闲块，与后继空闲块合并 */
+		block_header_t *rest = block_init((uint8_t *) header + total_size, remaining, BLOCK_FREE, NULL);
+		block_coalesce(pool, rest);
+		return true;
+	}
+
+	/* 扩大：检查后继块 */
+	block_header_t *next_header = (block_header_t *) ((uint8_t *) header + old_total);
+	if (!((uint8_t *) next_header + sizeof(block_header_t) <= ((uint8_t *) pool->start + pool->size)
+		&& next_header->magic == BLOCK_MAGIC
+		&& next_header->state == BLOCK_FREE
+		&& old_total + next_header->size >= total_size))
+		return false;
+
+	size_t combined = old_total + next_header->size;
+	freelist_remove(pool, next_header);
+
+	size_t remaining = combined - total_size;
+	if (remaining < MIN_SPLIT_SIZE) {
+		/* 剩余部分过小，整体吸收 */
+		total_size = combined;
+		remaining = 0;
+	}
+
+	header->size = total_size;
+	((block_footer_t *) ((uint8_t *) header + total_size - sizeof(block_footer_t)))->size = total_size;
+	stats_account(pool, header->task, (ptrdiff_t) (total_size - old_total));
+
+	if (remaining) {
+		block_header_t *rest = block_init((uint8_t *) header + total_size, remaining, BLOCK_FREE, NULL);
+		freelist_insert(pool, rest);
+	}
+	return true;
+}
+
+/*
+	@brief 原地调整已分配块的大小。
+	@param pool 待操作的内存池
+	@param header 已分配块头
+	@param total_size 新的块大小（包括头尾及分配域记录，已对齐）
+	@return 成功返回 true；后继块不是空闲块或空间不足时返回 false
+	@note 分配域记录位于块尾，随块大小移动。
+*/
+static bool block_resize(MEMORY_POOL *pool, block_header_t *header, size_t total_size)
+{
+	MEMORY_ARENA *arena = block_arena(header);
+	block_untrack(header);
+	bool resized = block_resize_untracked(pool, header, total_size);
+	block_track(header, arena);
+	return resized;
+}
+
 /*
 	@brief 初始化内存池。
 	@param pool 待初始化的内存池
@@ -48,20 +485,16 @@ void memory_init(MEMORY_POOL *pool, void *base, size_t size)
 	pool->size = aligned_size;
 
 	/* 初始化第一个内存块 */
-	block_header_t *header = (block_header_t *) aligned_base;
-	header->magic = BLOCK_MAGIC;
-	header->size = aligned_size;
-	header->state = BLOCK_FREE;
-	header->task = NULL;
+	block_header_t *header = block_init((void *) aligned_base, aligned_size, BLOCK_FREE, NULL);
 
-	block_footer_t *footer = (block_footer_t *) ((uint8_t *) aligned_base + aligned_size - sizeof(block_footer_t));
-	footer->size = aligned_size;
+	/* 初始化空闲索引 */
+	pool->fl_bitmap = 0;
+	memset(pool->sl_bitmap, 0, sizeof(pool->sl_bitmap));
+	memset(pool->free_lists, 0, sizeof(pool->free_lists));
+	freelist_insert(pool, header);
 
-	/* 初始化空闲列表 */
-	freeblock_t *freeblock = (freeblock_t *) ((uint8_t *) header + sizeof(block_header_t));
-	freeblock->prev = NULL;
-	freeblock->next = NULL;
-	pool->head = freeblock;
+	/* 初始化统计 */
+	memset(&pool->stats, 0, sizeof(pool->stats));
 
 	/* 初始化自旋锁 */
 	spinlock_init(&pool->lock);
@@ -78,60 +511,54 @@ void *memory_alloc(MEMORY_POOL *pool, size_t size, TASK *task)
 {
 	if (size == 0) return NULL;
 
-	size_t total_size = size + sizeof(block_header_t) + sizeof(block_footer_t);
-
-	/* 对齐到 ALLOC_ALIGNMENT */
-	total_size = ALIGN_UP(total_size, ALLOC_ALIGNMENT);
-
-	/* 遍历空闲列表 */
-	freeblock_t *current = pool->head;
-	while (current) {
-		block_header_t *header = (block_header_t *) ((uint8_t *) current - sizeof(block_header_t));
-		if (header->magic != BLOCK_MAGIC) return NULL;
-
-		if (header->size >= total_size) {
-			/* 足够大，整体分配或分割 */
-			size_t remaining = header->size - total_size;
-
-			if (remaining < ALIGN_UP(MIN_BLOCK_SIZE, ALLOC_ALIGNMENT)) {
-				/* 整体分配 */
-				/* 从空闲链表中移除当前块 */
-				if (current->prev) current->prev->next = current->next;
-				if (current->next) current->next->prev = current->prev;
-				if (pool->head == current) pool->head = current->next;
-			} else {
-				/* 分割 */
-				header->size = total_size;
-				block_footer_t *footer = (block_footer_t *) ((uint8_t *) header + total_size - sizeof(block_footer_t));
-				footer->size = total_size;
-
-				/* 创建新空闲块 */
-				block_header_t *new_header = (block_header_t *) ((uint8_t *) header + total_size);
-				new_header->magic = BLOCK_MAGIC;
-				new_header->size = remaining;
-				new_header->state = BLOCK_FREE;
-
-				block_footer_t *new_footer =
-					(block_footer_t *) ((uint8_t *) new_header + remaining - sizeof(block_footer_t));
-				new_footer->size = remaining;
-
-				/* 将新块加入空闲列表 */
-				freeblock_t *new_free = (freeblock_t *) ((uint8_t *) new_header + sizeof(block_header_t));
-				new_free->prev = current->prev;
-				new_free->next = current->next;
-				if (current->prev) current->prev->next = new_free;
-				if (current->next) current->next->prev = new_free;
-				if (pool->head == current) pool->head = new_free;
-			}
-
-			header->state = BLOCK_USED;
-			header->task = task;
-			return (void *) ((uint8_t *) header + sizeof(block_header_t));
-		}
-		current = current->next;
+	size_t total_size = block_size_for(size);
+
+	/* 查找空闲索引 */
+	block_header_t *header = freelist_find(pool, total_size);
+	if (!header) {
+		/* 内存不足 */
+		pool->stats.fail_count++;
+		return NULL;
 	}
-	/* 内存不足 */
-	return NULL;
+
+	/* 整体分配或分割 */
+	return block_carve(pool, header, 0, total_size, task);
+}
+
+/*
+	@brief 分配对齐的内存。
+	@param pool 待操作的内存池
+	@param size 需要分配的字节数
+	@param align 返回指针的对齐要求，须为 2 的幂
+	@param task 使用此内存的任务
+	@return 分配的内存指针，失败返回 NULL
+	@note 对齐产生的前部空隙作为空闲块保留在内存池中。
+*/
+void *memory_alloc_aligned(MEMORY_POOL *pool, size_t size, size_t align, TASK *task)
+{
+	if (size == 0 || align == 0 || (align & (align - 1))) return NULL;
+	if (align <= BLOCK_ALIGNMENT)
+		/* 数据区天然满足此对齐 */
+		return memory_alloc(pool, size, task);
+
+	size_t total_size = block_size_for(size);
+
+	/* 按最坏情况的前部空隙查找，保证找到的块一定能满足对齐 */
+	block_header_t *header = freelist_find(pool, total_size + align + MIN_LEAD_SIZE);
+	if (!header) {
+		/* 内存不足 */
+		pool->stats.fail_count++;
+		return NULL;
+	}
+
+	/* 计算满足对齐的数据区地址，前部空隙须能容纳一个空闲块 */
+	uintptr_t start = (uintptr_t) header;
+	uintptr_t user = ALIGN_UP(start + sizeof(block_header_t), align);
+	if (user - sizeof(block_header_t) != start && user - sizeof(block_header_t) - start < MIN_LEAD_SIZE)
+		user = ALIGN_UP(start + sizeof(block_header_t) + MIN_LEAD_SIZE, align);
+
+	size_t offset = user - sizeof(block_header_t) - start;
+	return block_carve(pool, header, offset, total_size, task);
 }
 
 /*
@@ -146,53 +573,15 @@ void memory_free(MEMORY_POOL *pool, void *ptr)
 	block_header_t *header = (block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t));
 	if (!(header->magic == BLOCK_MAGIC && header->state == BLOCK_USED)) return;
 
-	/* 标记为释放 */
+	/* 移出分配域并标记为释放 */
+	block_untrack(header);
+	pool->stats.free_count++;
+	stats_account(pool, header->task, -(ptrdiff_t) header->size);
 	header->state = BLOCK_FREE;
 	header->task = NULL;
 
 	/* 合并相邻空闲块 */
-
-	/* 向后合并 */
-	block_header_t *next_header = (block_header_t *) ((uint8_t *) header + header->size);
-	if ((uint8_t *) next_header + sizeof(block_header_t) <= ((uint8_t *) pool->start + pool->size)
-		&& next_header->magic == BLOCK_MAGIC
-		&& next_header->state == BLOCK_FREE) {
-		/* 合并 */
-		header->size += next_header->size;
-		block_footer_t *footer = (block_footer_t *) ((uint8_t *) header + header->size - sizeof(block_footer_t));
-		footer->size = header->size;
-
-		/* 从空闲列表中移除下一个块 */
-		freeblock_t *next_free = (freeblock_t *) ((uint8_t *) next_header + sizeof(block_header_t));
-		if (next_free->prev) next_free->prev->next = next_free->next;
-		if (next_free->next) next_free->next->prev = next_free->prev;
-		if (pool->head == next_free) pool->head = next_free->next;
-	}
-
-	/* 向前合并 */
-	if ((uint8_t *) header > (uint8_t *) pool->start) {
-		block_footer_t *prev_footer = (block_footer_t *) ((uint8_t *) header - sizeof(block_footer_t));
-		block_header_t *prev_header = (block_header_t *) ((uint8_t *) header - prev_footer->size);
-
-		if (prev_header->magic == BLOCK_MAGIC && prev_header->state == BLOCK_FREE) {
-			/* 合并 */
-			prev_header->size += header->size;
-			block_footer_t *footer =
-				(block_footer_t *) ((uint8_t *) prev_header + prev_header->size - sizeof(block_footer_t));
-			footer->size = prev_header->size;
-
-			/* 当前块已被合并，无需加入链表 */
-			return;
-		}
-	}
-
-	/* 将当前块加入空闲块列表 */
-	freeblock_t *new_free = (freeblock_t *) ((uint8_t *) header + sizeof(block_header_t));
-	new_free->prev = NULL;
-	new_free->next = pool->head;
-	if (pool->head) ((freeblock_t *) (pool->head))->prev = new_free;
-	pool->head = new_free;
-	return;
+	block_coalesce(pool, header);
 }
 
 /*
@@ -204,9 +593,9 @@ void memory_free(MEMORY_POOL *pool, void *ptr)
 */
 void *memory_alloc_irqsave(MEMORY_POOL *pool, size_t size, TASK *task)
 {
-	uint32_t eflags = spinlock_acquire_irqsave(&pool->lock);
+	uint32_t eflags = pool_lock(pool);
 	void *ptr = memory_alloc(pool, size, task);
-	spinlock_release_irqrestore(&pool->lock, eflags);
+	pool_unlock(pool, eflags);
 	return ptr;
 }
 
@@ -217,9 +606,262 @@ void *memory_alloc_irqsave(MEMORY_POOL *pool, size_t size, TASK *task)
 */
 void memory_free_irqsave(MEMORY_POOL *pool, void *ptr)
 {
-	uint32_t eflags = spinlock_acquire_irqsave(&pool->lock);
+	uint32_t eflags = pool_lock(pool);
 	memory_free(pool, ptr);
-	spinlock_release_irqrestore(&pool->lock, eflags);
+	pool_unlock(pool, eflags);
+}
+
+/*
+	@brief 进入分配域。此后该任务在开中断时经 kmalloc、kcalloc、kmalloc_aligned 分配的内存块均记录于此分配域中。
+	@param task 目标任务
+	@param arena 待初始化的分配域
+	@note 直接调用 memory_alloc 等内存池接口分配的内存块不归入分配域。
+*/
+void memory_arena_enter(TASK *task, MEMORY_ARENA *arena)
+{
+	arena->blocks.prev = &arena->blocks;
+	arena->blocks.next = &arena->blocks;
+	arena->bytes = 0;
+	arena->count = 0;
+	arena->parent = task->arena;
+	task->arena = arena;
+}
+
+/*
+	@brief 退出分配域但暂不释放。此后的分配不再归入此分配域，已记录的内存块仍由 memory_arena_release 回收。
+	@param task 目标任务
+	@param arena 当前分配域
+*/
+void memory_arena_leave(TASK *task, MEMORY_ARENA *arena)
+{
+	if (task->arena == arena)
+		task->arena = arena->parent;
+}
+
+/*
+	@brief 退出并释放分配域，回收其中全部内存块。
+	@param pool 分配域中内存块所属的内存池
+	@param task 目标任务
+	@param arena 待释放的分配域
+	@return 回收的字节数（包括头尾）
+	@note 须在开中断的普通上下文中调用，可能休眠。每次只在持有内存池锁期间释放一个内存块，以免长时间关闭中断。
+*/
+size_t memory_arena_release(MEMORY_POOL *pool, TASK *task, MEMORY_ARENA *arena)
+{
+	size_t reclaimed = 0;
+
+	/* 先恢复外层分配域，避免新分配的内存块再次进入此分配域 */
+	if (task->arena == arena)
+		task->arena = arena->parent;
+
+	/*
+		延迟释放环中可能仍有此分配域的内存块，须先归还，否则下面释放后排空时会再释放一次。
+		另一调用者正在排空时，它已取出的指针可能尚未归还，等它完成后再检查。
+	*/
+	for (;;) {
+		kfree_drain();
+		if (__atomic_load_n(&defer_tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&defer_head, __ATOMIC_ACQUIRE) &&
+			!__atomic_load_n(&defer_draining, __ATOMIC_ACQUIRE))
+			break;
+		task_sleep_ms(1);
+	}
+
+	for (;;) {
+		uint32_t eflags = pool_lock(pool);
+		MEMORY_LINK *link = arena->blocks.next;
+		if (link == &arena->blocks) {
+			pool_unlock(pool, eflags);
+			break;
+		}
+
+		block_header_t *header = trailer_to_header(LINK_TO_TRAILER(link));
+		reclaimed += header->size;
+		memory_free(pool, (uint8_t *) header + sizeof(block_header_t));
+		pool_unlock(pool, eflags);
+	}
+
+	return reclaimed;
+}
+
+/* 求请求大小所属的预清零类别 */
+static inline uint32_t zero_class(size_t size)
+{
+	return (size <= ZERO_MIN_SIZE ? ZERO_MIN_SHIFT : 32 - __builtin_clz((uint32_t) size - 1)) - ZERO_MIN_SHIFT;
+}
+
+/*
+	@brief 取出一个预清零内存块，并交给当前任务。
+	@param size 需要分配的字节数
+	@return 已清零的内存指针，对应类别暂无可用块时返回 NULL
+	@note 无论是否命中，都请求空闲任务为该类别补充新的内存块。
+*/
+static void *zero_take(size_t size)
+{
+	if (size < ZERO_MIN_SIZE || size > ZERO_MAX_SIZE)
+		return NULL;
+
+	uint32_t class = zero_class(size);
+	uint32_t eflags = spinlock_acquire_irqsave(&zero_lock);
+	void *ptr = zero_blocks[class];
+	zero_blocks[class] = NULL;
+	zero_wanted |= 1u << class;
+	if (ptr) zero_cached -= (size_t) 1 << (class + ZERO_MIN_SHIFT);
+	spinlock_release_irqrestore(&zero_lock, eflags);
+
+	TASK *task = task_get_current();
+	MEMORY_ARENA *arena = arena_for(task);
+	eflags = pool_lock(&g_mp);
+	if (!ptr) {
+		g_mp.stats.zero_misses++;
+		pool_unlock(&g_mp, eflags);
+		return NULL;
+	}
+
+	/* 多余的尾部归还内存池，其余部分交给当前任务及其分配域 */
+	block_header_t *header = (block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t));
+	g_mp.stats.zero_hits++;
+	g_mp.stats.zeroed_bytes -= header->size;
+	block_resize(&g_mp, header, block_size_for(arena_request(size, arena)));
+	header->task = task;
+	block_track(header, arena);
+	if (task) task->mem_bytes += header->size;
+	pool_unlock(&g_mp, eflags);
+	return ptr;
+}
+
+/* 归还全部预清零内存块，返回是否归还了内存 */
+static bool zero_reclaim(void)
+{
+	void *blocks[ZERO_CLASSES];
+	uint32_t eflags = spinlock_acquire_irqsave(&zero_lock);
+	memcpy(blocks, zero_blocks, sizeof(blocks));
+	memset(zero_blocks, 0, sizeof(zero_blocks));
+	zero_cached = 0;
+	spinlock_release_irqrestore(&zero_lock, eflags);
+
+	bool reclaimed = false;
+	eflags = pool_lock(&g_mp);
+	for (uint32_t i = 0; i < ZERO_CLASSES; i++)
+		if (blocks[i]) {
+			block_header_t *header = (block_header_t *) ((uint8_t *) blocks[i] - sizeof(block_header_t));
+			g_mp.stats.zeroed_bytes -= header->size;
+			memory_free(&g_mp, blocks[i]);
+			reclaimed = true;
+		}
+	pool_unlock(&g_mp, eflags);
+	return reclaimed;
+}
+
+/*
+	@brief 为一个曾被请求过的类别补充预清零内存块。
+	@return 补充或归还了内存块返回 true，无事可做或内存不足返回 false
+	@note 由空闲任务调用；清零在开中断、不持有任何锁的状态下进行，可随时被抢占。
+		  补充后将超出 ZERO_BUDGET 时，本次改为归还一个更大类别的缓存块，由下次调用补充；
+		  没有更大类别的缓存块时放弃补充该类别。
+*/
+bool kzero_refill(void)
+{
+	uint32_t eflags = spinlock_acquire_irqsave(&zero_lock);
+	uint32_t pending = zero_wanted;
+	for (uint32_t i = 0; i < ZERO_CLASSES; i++)
+		if (zero_blocks[i])
+			pending &= ~(1u << i);
+
+	/* 先补充小类别，其清零耗时短；超出预算时只挤掉更大类别的缓存块 */
+	uint32_t class;
+	size_t size;
+	for (;;) {
+		if (!pending) {
+			spinlock_release_irqrestore(&zero_lock, eflags);
+			return false;
+		}
+
+		class = __builtin_ctz(pending);
+		size = (size_t) 1 << (class + ZERO_MIN_SHIFT);
+		if (zero_cached + size <= ZERO_BUDGET)
+			break;
+
+		uint32_t victim = ZERO_CLASSES - 1;
+		while (victim > class && !zero_blocks[victim])
+			victim--;
+		if (victim > class) {
+			/* 归还最大的缓存块，该类别留待下次补充 */
+			void *ptr = zero_blocks[victim];
+			zero_blocks[victim] = NULL;
+			zero_cached -= (size_t) 1 << (victim + ZERO_MIN_SHIFT);
+			spinlock_release_irqrestore(&zero_lock, eflags);
+
+			eflags = pool_lock(&g_mp);
+			g_mp.stats.zeroed_bytes -= ((block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t)))->size;
+			memory_free(&g_mp, ptr);
+			pool_unlock(&g_mp, eflags);
+			return true;
+		}
+
+		/* 预算已被更小的类别占满，放弃补充此类别 */
+		zero_wanted &= ~(1u << class);
+		pending &= ~(1u << class);
+	}
+
+	zero_wanted &= ~(1u << class);
+	spinlock_release_irqrestore(&zero_lock, eflags);
+
+	/* 多留出分配域记录的空间，使取出后归入分配域时无需扩大 */
+	void *ptr = memory_alloc_irqsave(&g_mp, size + sizeof(block_trailer_t), NULL);
+	if (!ptr) return false;
+	memset(ptr, 0, size);
+
+	block_header_t *header = (block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t));
+	eflags = spinlock_acquire_irqsave(&zero_lock);
+	bool stored = !zero_blocks[class] && zero_cached + size <= ZERO_BUDGET;
+	if (stored) {
+		zero_blocks[class] = ptr;
+		zero_cached += size;
+	}
+	spinlock_release_irqrestore(&zero_lock, eflags);
+
+	if (!stored) {
+		memory_free_irqsave(&g_mp, ptr);
+		return false;
+	}
+
+	eflags = pool_lock(&g_mp);
+	g_mp.stats.zeroed_bytes += header->size;
+	pool_unlock(&g_mp, eflags);
+	return true;
+}
+
+/* 按大小选择 slab、页分配器或内存池，不输出分配轨迹 */
+static void *kmalloc_route(size_t size)
+{
+	TASK *task = task_get_current();
+	MEMORY_ARENA *arena = arena_for(task);
+
+	if (size <= KMALLOC_MAX_SIZE && !arena) {
+		/* 小对象由尺寸类别缓存服务；处于分配域中时须经由内存池以便跟踪 */
+		void *ptr = kmem_alloc(size);
+		if (ptr) return ptr;
+	}
+
+	if (size >= KMALLOC_PAGE_MIN_SIZE && !arena) {
+		/* 大缓冲区直接由页分配器服务 */
+		void *ptr = page_alloc_size(size);
+		if (ptr) return ptr;
+	}
+
+	uint32_t eflags = pool_lock(&g_mp);
+	void *ptr = memory_alloc(&g_mp, arena_request(size, arena), task);
+	if (ptr) block_track((block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t)), arena);
+	pool_unlock(&g_mp, eflags);
+
+	if (!ptr && zero_reclaim()) {
+		/* 内存不足时先归还预清零内存块再重试 */
+		eflags = pool_lock(&g_mp);
+		ptr = memory_alloc(&g_mp, arena_request(size, arena), task);
+		if (ptr) block_track((block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t)), arena);
+		pool_unlock(&g_mp, eflags);
+	}
+	return ptr;
 }
 
 /*
@@ -229,12 +871,110 @@ void memory_free_irqsave(MEMORY_POOL *pool, void *ptr)
 */
 void *kmalloc(size_t size)
 {
-	uint32_t eflags = spinlock_acquire_irqsave(&g_mp.lock);
-	void *ptr = memory_alloc(&g_mp, size, task_get_current());
-	spinlock_release_irqrestore(&g_mp.lock, eflags);
+	if (load_eflags() & EFLAGS_IF)
+		kfree_drain();
+
+	void *ptr = kmalloc_route(size);
+	memtrace("a %u %08x\n", (uint32_t) size, (uint32_t) (uintptr_t) ptr);
 	return ptr;
 }
 
+/*
+	@brief 分配对齐的内存。
+	@param size 需要分配的字节数
+	@param align 返回指针的对齐要求，须为 2 的幂
+	@return 分配的内存指针，失败返回 NULL
+	@note 返回的指针由 kfree 释放；krealloc 搬移数据时仅保证 ALLOC_ALIGNMENT 对齐。
+*/
+void *kmalloc_aligned(size_t size, size_t align)
+{
+	if (align == 0 || (align & (align - 1))) return NULL;
+	if (align <= ALLOC_ALIGNMENT)
+		/* 所有分配路径均满足默认对齐 */
+		return kmalloc(size);
+
+	TASK *task = task_get_current();
+	MEMORY_ARENA *arena = arena_for(task);
+	void *ptr = NULL;
+
+	if (size >= KMALLOC_PAGE_MIN_SIZE && align <= PAGE_SIZE && !arena)
+		/* 页分配器返回的块天然按页对齐 */
+		ptr = page_alloc_size(size);
+
+	if (!ptr) {
+		uint32_t eflags = pool_lock(&g_mp);
+		ptr = memory_alloc_aligned(&g_mp, arena_request(size, arena), align, task);
+		if (ptr) block_track((block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t)), arena);
+		pool_unlock(&g_mp, eflags);
+	}
+
+	memtrace("A %u %u %08x\n", (uint32_t) size, (uint32_t) align, (uint32_t) (uintptr_t) ptr);
+	return ptr;
+}
+
+/* 调整非空内存块的大小，不输出分配轨迹 */
+static void *krealloc_route(void *ptr, size_t new_size)
+{
+	if (kmem_owns(ptr)) {
+		/* slab 对象：尺寸类别足够时原地返回 */
+		size_t old_size = kmem_object_size(ptr);
+		if (new_size <= old_size)
+			return ptr;
+
+		void *new_ptr = kmalloc_route(new_size);
+		if (new_ptr) {
+			memcpy(new_ptr, ptr, old_size);
+			kmem_free(ptr);
+		}
+		return new_ptr;
+	}
+
+	if (page_owns(ptr)) {
+		/* 页分配器分配的块：容量足够时原地返回 */
+		size_t old_size = page_block_size(ptr);
+		if (new_size <= old_size)
+			return ptr;
+
+		void *new_ptr = kmalloc_route(new_size);
+		if (new_ptr) {
+			memcpy(new_ptr, ptr, old_size);
+			page_free(ptr);
+		}
+		return new_ptr;
+	}
+
+	uint32_t eflags = pool_lock(&g_mp);
+
+	block_header_t *header = (block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t));
+	if (!(header->magic == BLOCK_MAGIC && header->state == BLOCK_USED)) {
+		pool_unlock(&g_mp, eflags);
+		return NULL;
+	}
+
+	MEMORY_ARENA *arena = block_arena(header);
+	size_t old_size = block_capacity(header);
+	size_t total_size = block_size_for(arena_request(new_size, arena));
+	if (block_resize(&g_mp, header, total_size)) {
+		/* 原地缩小或吸收后继空闲块 */
+		g_mp.stats.realloc_inplace++;
+		pool_unlock(&g_mp, eflags);
+		return ptr;
+	}
+
+	/* 分配新内存并拷贝旧数据，新内存块沿用原内存块的任务与分配域 */
+	g_mp.stats.realloc_moved++;
+	void *new_ptr = memory_alloc(&g_mp, arena_request(new_size, arena), header->task);
+	if (new_ptr) {
+		block_header_t *new_header = (block_header_t *) ((uint8_t *) new_ptr - sizeof(block_header_t));
+		block_track(new_header, arena);
+
+		memcpy(new_ptr, ptr, old_size);
+		memory_free(&g_mp, ptr);
+	}
+	pool_unlock(&g_mp, eflags);
+	return new_ptr;
+}
+
 /*
 	@brief 重新分配内存块。
 	@param ptr 原内存指针
@@ -253,28 +993,8 @@ void *krealloc(void *ptr, size_t new_size)
 		return NULL;
 	}
 
-	uint32_t eflags = spinlock_acquire_irqsave(&g_mp.lock);
-
-	const block_header_t *header = (block_header_t *) ((uint8_t *) ptr - sizeof(block_header_t));
-	if (!(header->magic == BLOCK_MAGIC && header->state == BLOCK_USED)) {
-		spinlock_release_irqrestore(&g_mp.lock, eflags);
-		return NULL;
-	}
-
-	size_t old_size = header->size - sizeof(block_header_t) - sizeof(block_footer_t);
-	if (new_size <= old_size) {
-		/* 新尺寸小于等于旧尺寸，直接返回原指针 */
-		spinlock_release_irqrestore(&g_mp.lock, eflags);
-		return ptr;
-	}
-
-	/* 分配新内存并拷贝旧数据 */
-	void *new_ptr = memory_alloc(&g_mp, new_size, task_get_current());
-    if (new_ptr) {
-        memcpy(new_ptr, ptr, old_size);
-        memory_free(&g_mp, ptr);
-    }
-    spinlock_release_irqrestore(&g_mp.lock, eflags);
+	void *new_ptr = krealloc_route(ptr, new_size);
+	memtrace("r %08x %u %08x\n", (uint32_t) (uintptr_t) ptr, (uint32_t) new_size, (uint32_t) (uintptr_t) new_ptr);
 	return new_ptr;
 }
 
@@ -287,21 +1007,112 @@ void *krealloc(void *ptr, size_t new_size)
 void *kcalloc(size_t nmemb, size_t size)
 {
 	size_t total_size = nmemb * size;
-	void *ptr = kmalloc(total_size);
+
+	/* 优先使用空闲任务预先清零的内存块 */
+	void *ptr = zero_take(total_size);
+	if (ptr) {
+		memtrace("a %u %08x\n", (uint32_t) total_size, (uint32_t) (uintptr_t) ptr);
+		return ptr;
+	}
+
+	ptr = kmalloc(total_size);
 	if (ptr)
 		memset(ptr, 0, total_size); /* 清零分配的内存 */
 	return ptr;
 }
 
+/* 按所属分配器释放，不输出分配轨迹 */
+static void kfree_route(void *ptr)
+{
+	if (kmem_owns(ptr)) {
+		kmem_free(ptr);
+		return;
+	}
+
+	if (page_owns(ptr)) {
+		page_free(ptr);
+		return;
+	}
+
+	uint32_t eflags = pool_lock(&g_mp);
+	memory_free(&g_mp, ptr);
+	pool_unlock(&g_mp, eflags);
+}
+
+/*
+	@brief 将指针推入延迟释放环。
+	@param ptr 待释放的内存指针
+	@return 成功返回 true，环已满返回 false
+	@note 不获取任何锁，可在中断上下文中调用。
+*/
+static bool defer_push(void *ptr)
+{
+	uint32_t head = __atomic_load_n(&defer_head, __ATOMIC_RELAXED);
+	do {
+		if (head - __atomic_load_n(&defer_tail, __ATOMIC_ACQUIRE) >= DEFER_RING_SIZE)
+			return false;
+	} while (!__atomic_compare_exchange_n(&defer_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	/* 先预留位置再写入，消费者见到非空槽位才会取走 */
+	__atomic_store_n(&defer_ring[head & (DEFER_RING_SIZE - 1)], ptr, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+	@brief 释放延迟释放环中积压的内存。
+	@note 须在开中断的普通上下文中调用；由空闲任务与 kmalloc 调用，同一时刻只有一个调用者排空。
+*/
+void kfree_drain(void)
+{
+	if (__atomic_load_n(&defer_tail, __ATOMIC_RELAXED) == __atomic_load_n(&defer_head, __ATOMIC_ACQUIRE))
+		return;
+	if (__atomic_exchange_n(&defer_draining, true, __ATOMIC_ACQUIRE))
+		return;
+
+	uint32_t tail = defer_tail;
+	while (tail != __atomic_load_n(&defer_head, __ATOMIC_ACQUIRE)) {
+		void **slot = &defer_ring[tail & (DEFER_RING_SIZE - 1)];
+		void *ptr = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+		if (!ptr)
+			/* 生产者已预留但尚未写入 */
+			break;
+
+		*slot = NULL;
+		__atomic_store_n(&defer_tail, ++tail, __ATOMIC_RELEASE);
+		kfree_route(ptr);
+		__atomic_fetch_add(&g_mp.stats.deferred_frees, 1, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&defer_draining, false, __ATOMIC_RELEASE);
+}
+
 /*
 	@brief 释放内存。
 	@param ptr 待释放的内存指针
+	@note 关中断时（中断处理程序、定时器回调）仅将指针推入延迟释放环，不等待内存池锁。
 */
 void kfree(void *ptr)
 {
-	uint32_t eflags = spinlock_acquire_irqsave(&g_mp.lock);
-	memory_free(&g_mp, ptr);
-	spinlock_release_irqrestore(&g_mp.lock, eflags);
+	memtrace("f %08x\n", (uint32_t) (uintptr_t) ptr);
+	if (ptr == NULL) return;
+
+	if (load_eflags() & EFLAGS_IF) {
+		kfree_route(ptr);
+		return;
+	}
+
+	uint64_t start = tsc_khz ? rdtsc() : 0;
+	if (!defer_push(ptr)) {
+		/* 环已满，只能就地释放 */
+		__atomic_fetch_add(&g_mp.stats.defer_overflows, 1, __ATOMIC_RELAXED);
+		kfree_route(ptr);
+	}
+
+	if (start) {
+		uint64_t cycles = rdtsc() - start;
+		if (cycles > g_mp.stats.irq_free_max)
+			g_mp.stats.irq_free_max = cycles;
+	}
 }
 
 /*
@@ -311,19 +1122,79 @@ void kfree(void *ptr)
 size_t get_free_memory(const MEMORY_POOL *pool)
 {
 	size_t total_free = 0;
-	freeblock_t *current = pool->head;
-
-	while (current) {
-		const block_header_t *header = (block_header_t *) ((uint8_t *) current - sizeof(block_header_t));
+	uint32_t fl, sl;
+	const freeblock_t *current;
 
-		if (!(header->magic == BLOCK_MAGIC && header->state == BLOCK_FREE)) {
-			current = current->next;
+	for_each_free_block(pool, fl, sl, current) {
+		const block_header_t *header = NODE_TO_HEADER(current);
+		if (!(header->magic == BLOCK_MAGIC && header->state == BLOCK_FREE))
 			continue;
-		}
 
 		total_free += header->size - (sizeof(block_header_t) + sizeof(block_footer_t));
-		current = current->next;
 	}
 
 	return total_free;
 }
+
+/*
+	@brief 获取内存池快照。
+	@param pool 待查询的内存池
+	@param info 用于返回快照
+*/
+void memory_get_info(MEMORY_POOL *pool, MEMORY_INFO *info)
+{
+	memset(info, 0, sizeof(*info));
+
+	uint32_t eflags = pool_lock(pool);
+
+	info->stats = pool->stats;
+	info->total_size = pool->size;
+
+	uint32_t fl, sl;
+	const freeblock_t *current;
+	for_each_free_block(pool, fl, sl, current) {
+		const block_header_t *header = NODE_TO_HEADER(current);
+		if (!(header->magic == BLOCK_MAGIC && header->state == BLOCK_FREE))
+			continue;
+
+		info->free_bytes += header->size;
+		info->free_blocks++;
+		if (header->size > info->largest_free)
+			info->largest_free = header->size;
+
+		/* 按大小的最高位分桶 */
+		int32_t bucket = 31 - __builtin_clz(header->size) - MEMORY_HIST_MIN_SHIFT;
+		if (bucket < 0) bucket = 0;
+		if (bucket >= MEMORY_HIST_BUCKETS) bucket = MEMORY_HIST_BUCKETS - 1;
+		info->histogram[bucket]++;
+	}
+
+	pool_unlock(pool, eflags);
+}
+
+/*
+	@brief 通过串口输出内存池统计。
+	@param pool 待查询的内存池
+*/
+void memory_dump_info(MEMORY_POOL *pool)
+{
+	MEMORY_INFO info;
+	memory_get_info(pool, &info);
+
+	const MEMORY_STATS *stats = &info.stats;
+	debug("MEMORY: Pool %p, %u bytes\n", pool->start, info.total_size);
+	debug("  In use: %u bytes (peak %u), free: %u bytes in %u blocks, largest free: %u bytes\n",
+		stats->bytes_in_use, stats->peak_bytes, info.free_bytes, info.free_blocks, info.largest_free);
+	debug("  Allocs: %u, frees: %u, failures: %u\n", stats->alloc_count, stats->free_count, stats->fail_count);
+	debug("  krealloc in place: %u, moved: %u\n", stats->realloc_inplace, stats->realloc_moved);
+	debug("  Deferred frees: %u, overflows: %u\n", stats->deferred_frees, stats->defer_overflows);
+	debug("  Longest irq-off: %llu cycles holding lock, %llu cycles in kfree\n", stats->irqoff_max, stats->irq_free_max);
+	debug("  Pre-zeroed blocks: %u hits, %u misses, %u bytes cached\n", stats->zero_hits, stats->zero_misses, (uint32_t) stats->zeroed_bytes);
+	debug("  Free block histogram:\n");
+	for (int32_t i = 0; i < MEMORY_HIST_BUCKETS; i++)
+		if (info.histogram[i])
+			debug("    >= %8u: %u\n", i ? 1u << (i + MEMORY_HIST_MIN_SHIFT) : 0, info.histogram[i]);
+
+	for (TASK *task = task_iterate(NULL); task; task = task_iterate(task))
+		debug("  Task %d: %u bytes\n", TID(task), task->mem_bytes);
+}
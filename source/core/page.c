@@ -0,0 +1,395 @@
+/*
+	core/page.c
+*/
+
+#include <ClassiX/debug.h>
+#include <ClassiX/multiboot.h>
+#include <ClassiX/page.h>
+#include <ClassiX/spinlock.h>
+#include <ClassiX/typedef.h>
+
+#include <string.h>
+
+#define PAGE_ORDER_MASK						(0x1f)	/* 页描述字节中的阶 */
+#define PAGE_FREE							(0x20)	/* 空闲块的首页 */
+#define PAGE_USED							(0x40)	/* 已分配块的首页 */
+#define PAGE_CONT							(0x80)	/* 已分配块的后续分段 */
+
+#define PAGE_ADDR_LIMIT						(0x100000000ULL)	/* 仅管理 4 GiB 以下的物理内存 */
+
+#define PFN(addr)							((uint32_t) ((uintptr_t) (addr) >> PAGE_SHIFT))
+#define PFN_ADDR(pfn)						((void *) ((uintptr_t) (pfn) << PAGE_SHIFT))
+#define PAGE_DESC(pfn)						(page_map[(pfn) - page_base_pfn])
+
+static_assert(PAGE_MAX_ORDER <= PAGE_ORDER_MASK, "`PAGE_MAX_ORDER` does not fit in page descriptor");
+
+/* 空闲块链表节点，存放于空闲块首页 */
+typedef struct page_node_t {
+	struct page_node_t *prev;
+	struct page_node_t *next;
+} page_node_t;
+
+static uint8_t *page_map = NULL;							/* 页描述表，每页一字节 */
+static uint32_t page_base_pfn = 0;							/* 页描述表覆盖的起始页帧号 */
+static uint32_t page_map_count = 0;							/* 页描述表覆盖的页数 */
+static page_node_t *free_area[PAGE_MAX_ORDER + 1];			/* 各阶空闲块链表 */
+static size_t free_pages = 0;								/* 空闲页数 */
+static size_t total_pages = 0;								/* 受管理的页数 */
+static spinlock_t page_lock = SPINLOCK_INITIALIZER;			/* 页分配器锁 */
+
+/* 判断页帧号是否位于页描述表中 */
+static inline bool pfn_valid(uint32_t pfn)
+{
+	return pfn >= page_base_pfn && pfn - page_base_pfn < page_map_count;
+}
+
+/* 将空闲块插入对应阶的链表 */
+static inline void free_area_insert(uint32_t pfn, uint32_t order)
+{
+	page_node_t *node = (page_node_t *) PFN_ADDR(pfn);
+	node->prev = NULL;
+	node->next = free_area[order];
+	if (free_area[order]) free_area[order]->prev = node;
+	free_area[order] = node;
+
+	PAGE_DESC(pfn) = PAGE_FREE | order;
+	free_pages += 1u << order;
+}
+
+/* 将空闲块移出对应阶的链表 */
+static inline void free_area_remove(uint32_t pfn, uint32_t order)
+{
+	page_node_t *node = (page_node_t *) PFN_ADDR(pfn);
+	if (node->prev) node->prev->next = node->next;
+	if (node->next) node->next->prev = node->prev;
+	if (free_area[order] == node) free_area[order] = node->next;
+
+	PAGE_DESC(pfn) = 0;
+	free_pages -= 1u << order;
+}
+
+/*
+	@brief 释放块并与伙伴合并。
+	@param pfn 块的起始页帧号
+	@param order 块的阶
+*/
+static void block_release(uint32_t pfn, uint32_t order)
+{
+	while (order < PAGE_MAX_ORDER) {
+		uint32_t buddy = pfn ^ (1u << order);
+		if (!pfn_valid(buddy) || PAGE_DESC(buddy) != (PAGE_FREE | order))
+			break;
+
+		free_area_remove(buddy, order);
+		pfn &= ~(1u << order);
+		order++;
+	}
+	free_area_insert(pfn, order);
+}
+
+/*
+	@brief 分配指定阶的块。
+	@param order 块的阶
+	@param pfn 用于返回块的起始页帧号
+	@return 成功返回 true
+*/
+static bool block_acquire(uint32_t order, uint32_t *pfn)
+{
+	uint32_t current = order;
+	while (current <= PAGE_MAX_ORDER && !free_area[current])
+		current++;
+	if (current > PAGE_MAX_ORDER)
+		return false;
+
+	uint32_t base = PFN(free_area[current]);
+	free_area_remove(base, current);
+
+	/* 逐级对半分裂，后半部分放回空闲链表 */
+	while (current > order) {
+		current--;
+		free_area_insert(base + (1u << current), current);
+	}
+
+	*pfn = base;
+	return true;
+}
+
+/*
+	@brief 判断地址范围是否与保留区域重叠。
+	@param mbi Multiboot 信息结构
+	@param reserved_end 保留区域的结束地址
+	@param start 起始地址
+	@param end 结束地址（不含）
+	@return 重叠返回 true
+*/
+static bool range_reserved(const multiboot_info_t *mbi, uintptr_t reserved_end, uintptr_t start, uintptr_t end)
+{
+	/* 内核映像及页描述表 */
+	if (start < reserved_end)
+		return true;
+
+	/* Multiboot 信息结构及内存映射表，帧缓冲初始化时仍需使用 */
+	if (start < (uintptr_t) mbi + sizeof(multiboot_info_t) && (uintptr_t) mbi < end)
+		return true;
+	if (start < mbi->mmap_addr + mbi->mmap_length && mbi->mmap_addr < end)
+		return true;
+
+	return false;
+}
+
+/* 遍历可用的内存映射项 */
+#define for_each_available_region(mbi, mmap) \
+	for (mmap = (multiboot_memory_map_t *) (mbi)->mmap_addr; \
+		(uintptr_t) mmap < (mbi)->mmap_addr + (mbi)->mmap_length; \
+		mmap = (multiboot_memory_map_t *) ((uintptr_t) mmap + mmap->size + sizeof(mmap->size))) \
+		if (mmap->type == MULTIBOOT_MEMORY_AVAILABLE && mmap->addr < PAGE_ADDR_LIMIT)
+
+/* 求内存映射项中完整页的范围 */
+static inline void region_pfns(const multiboot_memory_map_t *mmap, uint32_t *start, uint32_t *end)
+{
+	uint64_t limit = mmap->addr + mmap->len;
+	if (limit > PAGE_ADDR_LIMIT)
+		limit = PAGE_ADDR_LIMIT;
+
+	*start = (uint32_t) ((mmap->addr + PAGE_SIZE - 1) >> PAGE_SHIFT);
+	*end = (uint32_t) (limit >> PAGE_SHIFT);
+}
+
+/*
+	@brief 根据 Multiboot 内存映射初始化页分配器。
+	@param mbi Multiboot 信息结构
+	@param reserved_end 保留区域（内核映像）的结束地址，此前的内存不被管理
+*/
+void page_init(const multiboot_info_t *mbi, uintptr_t reserved_end)
+{
+	multiboot_memory_map_t *mmap;
+	uint32_t min_pfn = UINT32_MAX, max_pfn = 0;
+
+	/* 确定可用内存覆盖的页帧号范围 */
+	for_each_available_region(mbi, mmap) {
+		uint32_t start, end;
+		region_pfns(mmap, &start, &end);
+		if (start >= end) continue;
+		if (start < min_pfn) min_pfn = start;
+		if (end > max_pfn) max_pfn = end;
+	}
+
+	if (min_pfn >= max_pfn) {
+		debug("PAGE: No available memory in memory map.\n");
+		return;
+	}
+
+	/* 在保留区域之后的可用内存中放置页描述表 */
+	size_t map_size = max_pfn - min_pfn;
+	uintptr_t map_addr = 0;
+	for_each_available_region(mbi, mmap) {
+		uint32_t start, end;
+		region_pfns(mmap, &start, &end);
+
+		uintptr_t candidate = (uintptr_t) PFN_ADDR(start);
+		if (candidate < reserved_end)
+			candidate = reserved_end;
+		candidate = (candidate + PAGE_SIZE - 1) & ~(uintptr_t) (PAGE_SIZE - 1);
+
+		if (candidate + map_size <= (uintptr_t) PFN_ADDR(end) &&
+			!range_reserved(mbi, reserved_end, candidate, candidate + map_size)) {
+			map_addr = candidate;
+			break;
+		}
+	}
+
+	if (!map_addr) {
+		debug("PAGE: Failed to place page map (%u bytes).\n", map_size);
+		return;
+	}
+
+	page_map = (uint8_t *) map_addr;
+	page_base_pfn = min_pfn;
+	page_map_count = map_size;
+	memset(page_map, 0, map_size);
+	if (map_addr + map_size > reserved_end)
+		reserved_end = map_addr + map_size;
+
+	for (uint32_t i = 0; i <= PAGE_MAX_ORDER; i++)
+		free_area[i] = NULL;
+
+	/* 逐页加入可用内存，由伙伴合并形成大块 */
+	for_each_available_region(mbi, mmap) {
+		uint32_t start, end;
+		region_pfns(mmap, &start, &end);
+
+		for (uint32_t pfn = start; pfn < end; pfn++) {
+			uintptr_t addr = (uintptr_t) PFN_ADDR(pfn);
+			if (range_reserved(mbi, reserved_end, addr, addr + PAGE_SIZE))
+				continue;
+			block_release(pfn, 0);
+			total_pages++;
+		}
+	}
+
+	debug("PAGE: Page allocator initialized, %u pages (%u KiB) available, page map at %p.\n",
+		total_pages, total_pages * (PAGE_SIZE / 1024), page_map);
+}
+
+/*
+	@brief 求容纳指定字节数所需的最小阶。
+	@param size 字节数
+	@return 阶，超过 `PAGE_MAX_ORDER` 表示无法分配
+*/
+uint32_t page_order(size_t size)
+{
+	uint32_t order = 0;
+	while (order <= PAGE_MAX_ORDER && ((size_t) PAGE_SIZE << order) < size)
+		order++;
+	return order;
+}
+
+/*
+	@brief 分配 2^order 个连续页。
+	@param order 阶
+	@return 按页对齐的内存指针，失败返回 NULL
+*/
+void *page_alloc(uint32_t order)
+{
+	if (order > PAGE_MAX_ORDER)
+		return NULL;
+	return page_alloc_size((size_t) PAGE_SIZE << order);
+}
+
+/*
+	@brief 分配能容纳指定字节数的连续页。
+	@param size 字节数
+	@return 按页对齐的内存指针，失败返回 NULL
+	@note 按阶分配后将未使用的尾部页归还，已分配部分记录为若干依次递减的分段。
+*/
+void *page_alloc_size(size_t size)
+{
+	if (size == 0)
+		return NULL;
+
+	uint32_t order = page_order(size);
+	if (order > PAGE_MAX_ORDER)
+		return NULL;
+
+	uint32_t eflags = spinlock_acquire_irqsave(&page_lock);
+
+	uint32_t pfn;
+	if (!block_acquire(order, &pfn)) {
+		spinlock_release_irqrestore(&page_lock, eflags);
+		return NULL;
+	}
+
+	void *addr = PFN_ADDR(pfn);
+	uint32_t need = (uint32_t) ((size + PAGE_SIZE - 1) >> PAGE_SHIFT);
+	uint8_t cont = 0;
+
+	for (;;) {
+		if (need == (1u << order)) {
+			/* 当前块恰好用尽 */
+			PAGE_DESC(pfn) = PAGE_USED | cont | order;
+			break;
+		}
+		if (need == 0) {
+			/* 剩余部分归还 */
+			free_area_insert(pfn, order);
+			break;
+		}
+
+		/* 对半分裂：前半部分用尽时记为一个分段并继续处理后半部分，否则归还后半部分 */
+		order--;
+		if (need >= (1u << order)) {
+			PAGE_DESC(pfn) = PAGE_USED | cont | order;
+			cont = PAGE_CONT;
+			pfn += 1u << order;
+			need -= 1u << order;
+		} else {
+			free_area_insert(pfn + (1u << order), order);
+		}
+	}
+
+	spinlock_release_irqrestore(&page_lock, eflags);
+	return addr;
+}
+
+/*
+	@brief 释放由 `page_alloc` 或 `page_alloc_size` 分配的页。
+	@param addr 内存指针
+*/
+void page_free(void *addr)
+{
+	if (addr == NULL) return;
+
+	uint32_t eflags = spinlock_acquire_irqsave(&page_lock);
+
+	uint32_t pfn = PFN(addr);
+	if (((uintptr_t) addr & (PAGE_SIZE - 1)) || !pfn_valid(pfn) ||
+		(PAGE_DESC(pfn) & (PAGE_USED | PAGE_CONT)) != PAGE_USED) {
+		spinlock_release_irqrestore(&page_lock, eflags);
+		debug("PAGE: Invalid free of %p.\n", addr);
+		return;
+	}
+
+	/* 依次释放各分段 */
+	do {
+		uint32_t order = PAGE_DESC(pfn) & PAGE_ORDER_MASK;
+		PAGE_DESC(pfn) = 0;
+		block_release(pfn, order);
+		pfn += 1u << order;
+	} while (pfn_valid(pfn) && (PAGE_DESC(pfn) & (PAGE_USED | PAGE_CONT)) == (PAGE_USED | PAGE_CONT));
+
+	spinlock_release_irqrestore(&page_lock, eflags);
+}
+
+/*
+	@brief 判断指针是否为页分配器分配的块的起始地址。
+	@param addr 内存指针
+	@return 是则返回 true
+*/
+bool page_owns(const void *addr)
+{
+	if (!page_map || ((uintptr_t) addr & (PAGE_SIZE - 1)))
+		return false;
+
+	uint32_t pfn = PFN(addr);
+	return pfn_valid(pfn) && (PAGE_DESC(pfn) & (PAGE_USED | PAGE_CONT)) == PAGE_USED;
+}
+
+/*
+	@brief 获取页分配器分配的块的大小。
+	@param addr 块的起始地址
+	@return 块的字节数，无效地址返回 0
+*/
+size_t page_block_size(const void *addr)
+{
+	if (!page_owns(addr))
+		return 0;
+
+	size_t pages = 0;
+	uint32_t pfn = PFN(addr);
+	uint8_t desc = PAGE_DESC(pfn);
+	do {
+		uint32_t order = desc & PAGE_ORDER_MASK;
+		pages += 1u << order;
+		pfn += 1u << order;
+	} while (pfn_valid(pfn) && ((desc = PAGE_DESC(pfn)) & (PAGE_USED | PAGE_CONT)) == (PAGE_USED | PAGE_CONT));
+
+	return pages * PAGE_SIZE;
+}
+
+/*
+	@brief 获取空闲页数。
+	@return 空闲页数
+*/
+size_t page_get_free_count(void)
+{
+	return free_pages;
+}
+
+/*
+	@brief 获取受管理的页数。
+	@return 页数
+*/
+size_t page_get_total_count(void)
+{
+	return total_pages;
+}
@@ -32,6 +32,7 @@ static int32_t handle_table_expand(HANDLE_TABLE *table)
 		new_entries[i].next_free = table->free_list_head;
 		new_entries[i].generation = 0;
 		new_entries[i].flags = 0;
+		new_entries[i].destructor = NULL;
 		table->free_list_head = (int32_t) i;
 	}
 
@@ -60,6 +61,7 @@ int32_t handle_table_init(HANDLE_TABLE *table, uint32_t initial_capacity, uint32
 		table->entries[i].next_free = (int32_t) i + 1;
 		table->entries[i].flags = 0;
 		table->entries[i].generation = 0;
+		table->entries[i].destructor = NULL;
 	}
 	table->entries[initial_capacity - 1].next_free = -1; /* 末尾 */
 	table->free_list_head = 0;
@@ -71,19 +73,46 @@ int32_t handle_table_init(HANDLE_TABLE *table, uint32_t initial_capacity, uint32
 }
 
 /*
-	@brief 销毁句柄表。
+	@brief 判断槽位是否与句柄匹配。
+	@param table 句柄表
+	@param handle 句柄
+	@return 匹配返回 true
+	@note 该函数假设调用者已持有句柄表的锁。
+*/
+static inline bool handle_entry_valid(const HANDLE_TABLE *table, HANDLE handle)
+{
+	if (handle.index >= table->capacity)
+		return false;
+
+	const HANDLE_ENTRY *entry = &table->entries[handle.index];
+	return (entry->flags & HANDLE_ENTRY_USED) &&
+		entry->generation == handle.generation &&
+		(entry->flags & HANDLE_FLAGS_MASK) == handle.flags;
+}
+
+/*
+	@brief 销毁句柄表，并对仍被占用的句柄调用析构函数。
 	@param table 句柄表
 */
 void handle_table_destroy(HANDLE_TABLE *table)
 {
-	if (table && table->entries) {
-		spinlock_acquire(&table->lock);
-		kfree(table->entries);
-		table->entries = NULL;
-		table->capacity = 0;
-		table->free_list_head = -1;
-		spinlock_release(&table->lock);
-	}
+	if (!table || !table->entries)
+		return;
+
+	spinlock_acquire(&table->lock);
+	HANDLE_ENTRY *entries = table->entries;
+	uint32_t capacity = table->capacity;
+	table->entries = NULL;
+	table->capacity = 0;
+	table->free_list_head = -1;
+	spinlock_release(&table->lock);
+
+	/* 在锁外调用析构函数，析构函数可能再次访问句柄表 */
+	for (uint32_t i = 0; i < capacity; i++)
+		if ((entries[i].flags & HANDLE_ENTRY_USED) && entries[i].destructor)
+			entries[i].destructor(entries[i].object);
+
+	kfree(entries);
 }
 
 /*
@@ -117,12 +146,13 @@ HANDLE handle_table_alloc(HANDLE_TABLE *table, void *object, uint32_t flags, voi
 
 	/* 初始化分配的槽位 */
 	entry->object = object;
-	entry->flags = flags & 0b00000011; /* 仅保留低两位作为标志 */
+	entry->flags = (flags & HANDLE_FLAGS_MASK) | HANDLE_ENTRY_USED; /* 仅保留低两位作为标志 */
+	entry->destructor = destructor;
 	entry->generation = (entry->generation + 1) & 0xFF;
 	if (entry->generation == 0)
 		entry->generation = 1; /* 代数递增，保持在 1-255 */
 
-	handle.flags = entry->flags;
+	handle.flags = flags & HANDLE_FLAGS_MASK;
 	handle.generation = entry->generation;
 	handle.index = (uint32_t) index;
 
@@ -142,24 +172,27 @@ void handle_table_free(HANDLE_TABLE *table, HANDLE handle)
 
 	spinlock_acquire(&table->lock);
 
-	if (handle.index >= table->capacity ||
-		table->entries[handle.index].object == NULL ||
-		table->entries[handle.index].generation != handle.generation ||
-		table->entries[handle.index].flags != handle.flags) {
+	if (!handle_entry_valid(table, handle)) {
 		/* 无效句柄 */
 		debug("HANDLE: Invalid handle 0x%08x\n", handle.value);
 		spinlock_release(&table->lock);
 		return;
 	}
 
-	table->entries[handle.index].next_free = table->free_list_head; /* 加入空闲链表 */
+	/* object 与 next_free 共用存储，须在加入空闲链表前取出 */
+	HANDLE_ENTRY *entry = &table->entries[handle.index];
+	void *object = entry->object;
+	void (*destructor)(void *) = entry->destructor;
+
+	entry->flags = 0;
+	entry->destructor = NULL;
+	entry->next_free = table->free_list_head; /* 加入空闲链表 */
 	table->free_list_head = (int32_t) handle.index;
-	table->entries[handle.index].object = NULL;
 
-	if (table->entries[handle.index].destructor)
-		table->entries[handle.index].destructor(table->entries[handle.index].object);
+	spinlock_release(&table->lock);
 
-	spinlock_release(&table->lock);		
+	if (destructor)
+		destructor(object);
 }
 
 /*
@@ -175,10 +208,7 @@ void *handle_table_lookup(HANDLE_TABLE *table, HANDLE handle)
 
 	spinlock_acquire(&table->lock);
 
-	if (handle.index >= table->capacity ||
-		table->entries[handle.index].object == NULL ||
-		table->entries[handle.index].generation != handle.generation ||
-		table->entries[handle.index].flags != handle.flags) {
+	if (!handle_entry_valid(table, handle)) {
 		/* 无效句柄 */
 		debug("HANDLE: Invalid handle 0x%08x\n", handle.value);
 		spinlock_release(&table->lock);
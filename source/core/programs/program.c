@@ -84,23 +84,30 @@ int32_t program_exec(int32_t argc, char **argv)
 	uint8_t *buf = NULL;
 	uint8_t *mem = NULL;
 	int32_t result = 0;
+	size_t reclaimed = 0;
 	TASK *task = task_get_current();
+	MEMORY_ARENA arena;	/* 本次运行期间分配的内存 */
 
 	if (argv == NULL || *argv == NULL) {
 		debug("PROGRAM: Invalid command line arguments.\n");
 		return SRV_INVALID_PARAM; /* 非法参数 */
 	}
 
+	/* 此后至程序启动前本任务分配的内存（程序镜像、文件缓冲区、句柄表等）在程序退出时统一回收 */
+	memory_arena_enter(task, &arena);
+
 	FAT_FILE file;
 	if (fatfs_open_file(&file, g_fs, argv[0]) != FATFS_SUCCESS) {
 		debug("PROGRAM: File `%s` not found.\n", argv[0]);
-		return SRV_NOT_FOUND; /* 未找到文件 */
+		result = SRV_NOT_FOUND; /* 未找到文件 */
+		goto clean;
 	}
 
 	buf = kmalloc(file.entry->file_size);
 	if (NULL == buf) {
 		debug("PROGRAM: Failed to allocate memory for program file.\n");
-		return SRV_MEMORY_ALLOC; /* 分配内存失败 */
+		result = SRV_MEMORY_ALLOC; /* 分配内存失败 */
+		goto clean;
 	}
 
 	uint32_t bytes_read = 0;
@@ -155,13 +162,12 @@ int32_t program_exec(int32_t argc, char **argv)
 		goto clean;
 	}
 
-	mem = kmalloc(runtime_size);
+	mem = kcalloc(1, runtime_size); /* 已清零的内存 */
 	if (NULL == mem) {
 		debug("PROGRAM: Failed to allocate memory for program execution.\n");
 		result = SRV_MEMORY_ALLOC; /* 分配内存失败 */
 		goto clean;
 	}
-	memset(mem, 0, runtime_size); /* 清零内存 */
 
 	debug("PROGRAM: Loaded program file\n");
 	debug("  File information\n");
@@ -206,9 +212,6 @@ int32_t program_exec(int32_t argc, char **argv)
 	set_ldt_descriptor(&task->ldt[0], task->code_base, task->code_limit, AR_3_CODE32_ER);
 	set_ldt_descriptor(&task->ldt[1], task->data_base, task->data_limit, AR_3_DATA32_RW);
 
-	/* 设置 LDT 选择子 */
-	task->tss.ldtr = task->selector + (MAX_TASKS * 8);
-
 	/* 段选择子（LDT 索引 0 和 1，TI=1，RPL=3） */
 	uint32_t code_selector = (0 << 3) | (1 << 2) | 3; /* 索引 0, TI=1, RPL=3 */
 	uint32_t data_selector = (1 << 3) | (1 << 2) | 3; /* 索引 1, TI=1, RPL=3 */
@@ -216,22 +219,32 @@ int32_t program_exec(int32_t argc, char **argv)
 	/* 用户栈指针 */
 	uint32_t user_esp_offset = runtime_size;
 
+	/* 入口点位于文件缓冲区中的程序头内，须在释放缓冲区前取出 */
+	uint32_t entry_point = header->entry_point;
+	header = NULL;
+
 	/* 释放文件缓冲区 */
 	kfree(buf);
 	buf = NULL;
 
+	/* 系统调用中分配的内核对象由句柄管理，可能是全局状态的一部分，不再归入分配域 */
+	memory_arena_leave(task, &arena);
+
 	/* 启动程序 */
-	asm volatile("lldt %0"::"m" (task->tss.ldtr));
-	program_start(header->entry_point, code_selector, user_esp_offset, data_selector, &task->tss.esp0);
+	task_load_ldt(task);
+	program_start(entry_point, code_selector, user_esp_offset, data_selector, &g_tss.esp0);
+
+	/* 调用 SYSCALL_EXIT 后返回，此后任务不再使用 LDT */
+	task->tss.ldtr = 0;
 
-	/* 调用 SYSCALL_EXIT 后返回 */
-	kfree(mem);
-	return 0;
+	/* 销毁程序遗留的句柄 */
+	handle_table_destroy(&task->hfile_table);
+	handle_table_destroy(&task->hwnd_table);
 
-	/* 释放临时缓冲区 */
+	/* 回收加载期间分配的全部内存（程序镜像、句柄表及打开程序文件时的目录项等） */
 clean:
-	if (mem) kfree(mem);
-	if (buf) kfree(buf);
+	reclaimed = memory_arena_release(&g_mp, task, &arena);
+	debug("PROGRAM: Reclaimed %u bytes from program %d.\n", reclaimed, TID(task));
 
 	return result;
 }
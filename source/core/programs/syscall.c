@@ -8,6 +8,8 @@
 #include <ClassiX/io.h>
 #include <ClassiX/memory.h>
 #include <ClassiX/programs.h>
+#include <ClassiX/slab.h>
+#include <ClassiX/spinlock.h>
 #include <ClassiX/task.h>
 #include <ClassiX/font.h>
 #include <ClassiX/window.h>
@@ -106,6 +108,19 @@ static const BITMAP_FONT *select_user_font(uint32_t font_id)
 	}
 }
 
+static KMEM_CACHE *window_cache = NULL;	/* 应用程序窗口对象缓存 */
+static spinlock_t window_cache_lock = SPINLOCK_INITIALIZER;	/* 保护窗口对象缓存的创建 */
+
+/*
+	@brief 窗口句柄的析构函数：销毁窗口并归还窗口对象。
+	@param object 窗口对象
+*/
+static void window_release(void *object)
+{
+	window_destroy((WINDOW *) object);
+	kmem_cache_free(window_cache, object);
+}
+
 typedef uint32_t (*syscall_handler_t)(uint32_t edi, uint32_t esi, uint32_t ebp, uint32_t esp, uint32_t ebx, uint32_t edx, uint32_t ecx, uint32_t eax);
 
 /*
@@ -120,7 +135,7 @@ static uint32_t syscall_exit_process(uint32_t edi, uint32_t esi, uint32_t ebp, u
 	uint32_t exit_code = ebx;
 
 	debug("SYSCALL: Program %d exited with code %d.\n", TID(task), exit_code);
-	return (uint32_t) &(task->tss.esp0);
+	return (uint32_t) &g_tss.esp0;
 }
 
 /*
@@ -148,14 +163,14 @@ static uint32_t syscall_wait_event(uint32_t edi, uint32_t esi, uint32_t ebp, uin
 
 	if (!(verify_user_pointer(task, ebx + task->data_base, sizeof(EVENT)) && verify_user_pointer(task, ecx + task->data_base, sizeof(uint32_t)))) {
 		debug("SYSCALL: Invalid pointer passed to wait_event: 0x%08x\n", ebx);
-		return (uint32_t) &(task->tss.esp0); /* 强制结束程序 */
+		return (uint32_t) &g_tss.esp0; /* 强制结束程序 */
 	}
 
 	for (;;) {
 		cli();
 		if (fifo_status(&task->fifo) == 0) {
 			sti();
-			task_sleep(task);
+			fifo_wait(&task->fifo, 3);
 		} else {
 			EVENT event;
 			fifo_pop_event(&task->fifo, &event);
@@ -187,7 +202,15 @@ static uint32_t syscall_window_create(uint32_t edi, uint32_t esi, uint32_t ebp,
 	uint16_t width = HIGH16(edx);
 	uint16_t height = LOW16(edx);
 
-	WINDOW *window = memory_alloc_irqsave(&g_mp, sizeof(WINDOW), task);
+	if (!window_cache) {
+		/* 首次使用时创建对象缓存；多个程序可能同时首次创建窗口 */
+		uint32_t eflags = spinlock_acquire_irqsave(&window_cache_lock);
+		if (!window_cache)
+			window_cache = kmem_cache_create("window", sizeof(WINDOW), 0);
+		spinlock_release_irqrestore(&window_cache_lock, eflags);
+	}
+
+	WINDOW *window = kmem_cache_alloc(window_cache);
 	if (!window) {
 		debug("SYSCALL: Failed to allocate memory for window.\n");
 		return 0; /* 内存分配失败，返回无效句柄 */
@@ -196,18 +219,18 @@ static uint32_t syscall_window_create(uint32_t edi, uint32_t esi, uint32_t ebp,
 	int32_t result = window_create(window, 0, 0, width, height, style, STARTUP_POS_CASCADE, title, task);
 	if (result != WD_SUCCESS) {
 		debug("SYSCALL: Failed to create window (error code: %d).\n", result);
-		memory_free_irqsave(&g_mp, window);
+		kmem_cache_free(window_cache, window);
 		return 0; /* 窗口创建失败，返回无效句柄 */
 	}
 
 	// 暂时自动激活
 	window_activate(window);
 
-	HANDLE hwnd = handle_table_alloc(&task->hwnd_table, window, 0, (void (*)(void *)) &window_destroy);
+	HANDLE hwnd = handle_table_alloc(&task->hwnd_table, window, 0, &window_release);
 	if (hwnd.value == 0) {
 		debug("SYSCALL: Failed to allocate handle for window.\n");
 		window_destroy(window);
-		memory_free_irqsave(&g_mp, window);
+		kmem_cache_free(window_cache, window);
 		return 0; /* 句柄分配失败，返回无效句柄 */
 	}
 
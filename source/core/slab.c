@@ -0,0 +1,368 @@
+/*
+	core/slab.c
+*/
+
+#include <ClassiX/debug.h>
+#include <ClassiX/memory.h>
+#include <ClassiX/slab.h>
+#include <ClassiX/spinlock.h>
+#include <ClassiX/typedef.h>
+
+#include <string.h>
+
+#define SLAB_MAGIC							(0x5eb1ab00)	/* slab 魔数 */
+#define SLAB_DEFAULT_ALIGN					(8)				/* 默认对象对齐 */
+
+#define SLAB_OF(obj)						((slab_t *) ((uintptr_t) (obj) & ~(uintptr_t) (SLAB_SIZE - 1)))
+
+typedef struct slab_t {
+	uint32_t magic;
+	KMEM_CACHE *cache;		/* 所属缓存 */
+	struct slab_t *prev;
+	struct slab_t *next;
+	void *free;				/* 空闲对象链表 */
+	uint32_t inuse;			/* 已分配的对象数 */
+} slab_t;
+
+static KMEM_CACHE *cache_chain = NULL;						/* 所有缓存 */
+static spinlock_t cache_chain_lock = SPINLOCK_INITIALIZER;	/* 保护缓存链表 */
+
+/* slab 页位图：标记内核内存池中哪些页属于 slab */
+static uint32_t *slab_map = NULL;
+static uintptr_t slab_map_base;
+static size_t slab_map_pages;
+
+/* 尺寸类别 */
+static const size_t kmalloc_sizes[] = { 16, 32, 64, 96, 128, 192, 256, 512 };
+static const char *const kmalloc_names[] = {
+	"kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-96",
+	"kmalloc-128", "kmalloc-192", "kmalloc-256", "kmalloc-512"
+};
+static KMEM_CACHE *kmalloc_caches[ARRAY_SIZE(kmalloc_sizes)];
+static uint8_t kmalloc_index[KMALLOC_MAX_SIZE / KMALLOC_MIN_SIZE];	/* (size - 1) / 16 -> 类别 */
+
+static_assert(ARRAY_SIZE(kmalloc_sizes) == ARRAY_SIZE(kmalloc_names), "size class tables mismatch");
+
+/* 设置 slab 页标记 */
+static inline void slab_map_set(const slab_t *slab, bool value)
+{
+	size_t index = ((uintptr_t) slab - slab_map_base) / SLAB_SIZE;
+	if (value)
+		slab_map[index / 32] |= 1u << (index % 32);
+	else
+		slab_map[index / 32] &= ~(1u << (index % 32));
+}
+
+/* 将 slab 插入链表头部 */
+static inline void slab_push(void **list, slab_t *slab)
+{
+	slab->prev = NULL;
+	slab->next = *list;
+	if (*list)
+		((slab_t *) *list)->prev = slab;
+	*list = slab;
+}
+
+/* 将 slab 从链表中移除 */
+static inline void slab_unlink(void **list, slab_t *slab)
+{
+	if (slab->prev) slab->prev->next = slab->next;
+	if (slab->next) slab->next->prev = slab->prev;
+	if (*list == slab) *list = slab->next;
+	slab->prev = slab->next = NULL;
+}
+
+/*
+	@brief 为缓存新建一个 slab。
+	@param cache 目标缓存
+	@return 新 slab，失败返回 NULL
+*/
+static slab_t *slab_create(KMEM_CACHE *cache)
+{
+	uint32_t eflags = spinlock_acquire_irqsave(&g_mp.lock);
+	slab_t *slab = memory_alloc_aligned(&g_mp, SLAB_SIZE, SLAB_SIZE, NULL);
+	spinlock_release_irqrestore(&g_mp.lock, eflags);
+	if (!slab) {
+		debug("SLAB: Failed to allocate slab for cache `%s`.\n", cache->name);
+		return NULL;
+	}
+
+	slab->magic = SLAB_MAGIC;
+	slab->cache = cache;
+	slab->prev = slab->next = NULL;
+	slab->inuse = 0;
+
+	/* 串起空闲对象 */
+	uint8_t *obj = (uint8_t *) slab + cache->offset;
+	slab->free = obj;
+	for (uint32_t i = 0; i < cache->objs_per_slab - 1; i++, obj += cache->size)
+		*(void **) obj = obj + cache->size;
+	*(void **) obj = NULL;
+
+	slab_map_set(slab, true);
+	cache->slabs++;
+	return slab;
+}
+
+/*
+	@brief 将 slab 归还内存池。
+	@param slab 待销毁的 slab
+*/
+static void slab_destroy(slab_t *slab)
+{
+	slab->cache->slabs--;
+	slab->magic = 0;
+	slab_map_set(slab, false);
+
+	uint32_t eflags = spinlock_acquire_irqsave(&g_mp.lock);
+	memory_free(&g_mp, slab);
+	spinlock_release_irqrestore(&g_mp.lock, eflags);
+}
+
+/*
+	@brief 初始化 slab 分配器及尺寸类别缓存。
+	@note 须在 `memory_init` 初始化 `g_mp` 之后调用。
+*/
+void kmem_init(void)
+{
+	slab_map_base = (uintptr_t) g_mp.start & ~(uintptr_t) (SLAB_SIZE - 1);
+	slab_map_pages = ((uintptr_t) g_mp.start + g_mp.size - slab_map_base + SLAB_SIZE - 1) / SLAB_SIZE;
+
+	size_t map_size = (slab_map_pages + 31) / 32 * sizeof(uint32_t);
+	slab_map = memory_alloc_irqsave(&g_mp, map_size, NULL);
+	if (!slab_map) {
+		debug("SLAB: Failed to allocate slab map.\n");
+		return;
+	}
+	memset(slab_map, 0, map_size);
+
+	size_t class = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(kmalloc_index); i++) {
+		while ((i + 1) * KMALLOC_MIN_SIZE > kmalloc_sizes[class])
+			class++;
+		kmalloc_index[i] = class;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(kmalloc_sizes); i++)
+		kmalloc_caches[i] = kmem_cache_create(kmalloc_names[i], kmalloc_sizes[i], KMALLOC_MIN_SIZE);
+
+	debug("SLAB: Slab allocator initialized, %u pages tracked.\n", slab_map_pages);
+}
+
+/*
+	@brief 创建对象缓存。
+	@param name 缓存名称
+	@param size 对象大小
+	@param align 对象对齐，0 表示默认对齐
+	@return 新缓存，失败返回 NULL
+*/
+KMEM_CACHE *kmem_cache_create(const char *name, size_t size, size_t align)
+{
+	if (align == 0)
+		align = SLAB_DEFAULT_ALIGN;
+	if (size == 0 || (align & (align - 1)))
+		return NULL;
+
+	size_t obj_size = ALIGN_UP(size < sizeof(void *) ? sizeof(void *) : size, align);
+	size_t offset = ALIGN_UP(sizeof(slab_t), align);
+	if (offset + obj_size > SLAB_SIZE) {
+		debug("SLAB: Object size %u too large for cache `%s`.\n", size, name);
+		return NULL;
+	}
+
+	KMEM_CACHE *cache = memory_alloc_irqsave(&g_mp, sizeof(KMEM_CACHE), NULL);
+	if (!cache) {
+		debug("SLAB: Failed to allocate cache `%s`.\n", name);
+		return NULL;
+	}
+
+	cache->name = name;
+	cache->size = obj_size;
+	cache->offset = offset;
+	cache->objs_per_slab = (SLAB_SIZE - offset) / obj_size;
+	cache->partial = NULL;
+	cache->full = NULL;
+	cache->empty = NULL;
+	cache->slabs = 0;
+	cache->active = 0;
+	spinlock_init(&cache->lock);
+
+	uint32_t eflags = spinlock_acquire_irqsave(&cache_chain_lock);
+	cache->next = cache_chain;
+	cache_chain = cache;
+	spinlock_release_irqrestore(&cache_chain_lock, eflags);
+
+	debug("SLAB: Created cache `%s`, object size %u, %u objects per slab.\n", name, obj_size, cache->objs_per_slab);
+	return cache;
+}
+
+/*
+	@brief 销毁对象缓存。
+	@param cache 待销毁的缓存
+	@note 缓存中仍有已分配对象时拒绝销毁。
+*/
+void kmem_cache_destroy(KMEM_CACHE *cache)
+{
+	if (!cache)
+		return;
+
+	uint32_t eflags = spinlock_acquire_irqsave(&cache->lock);
+	if (cache->active) {
+		spinlock_release_irqrestore(&cache->lock, eflags);
+		debug("SLAB: Cache `%s` still has %u active objects.\n", cache->name, cache->active);
+		return;
+	}
+
+	/* 没有活动对象时，所有 slab 都在空 slab 或部分链表中 */
+	if (cache->empty)
+		slab_destroy(cache->empty);
+	while (cache->partial) {
+		slab_t *slab = cache->partial;
+		slab_unlink(&cache->partial, slab);
+		slab_destroy(slab);
+	}
+	spinlock_release_irqrestore(&cache->lock, eflags);
+
+	eflags = spinlock_acquire_irqsave(&cache_chain_lock);
+	for (KMEM_CACHE **p = &cache_chain; *p; p = &(*p)->next)
+		if (*p == cache) {
+			*p = cache->next;
+			break;
+		}
+	spinlock_release_irqrestore(&cache_chain_lock, eflags);
+
+	memory_free_irqsave(&g_mp, cache);
+}
+
+/*
+	@brief 从缓存分配一个对象。
+	@param cache 目标缓存
+	@return 对象指针，失败返回 NULL
+*/
+void *kmem_cache_alloc(KMEM_CACHE *cache)
+{
+	if (!cache)
+		return NULL;
+
+	uint32_t eflags = spinlock_acquire_irqsave(&cache->lock);
+
+	slab_t *slab = cache->partial;
+	if (!slab) {
+		if (cache->empty) {
+			slab = cache->empty;
+			cache->empty = NULL;
+		} else {
+			slab = slab_create(cache);
+			if (!slab) {
+				spinlock_release_irqrestore(&cache->lock, eflags);
+				return NULL;
+			}
+		}
+		slab_push(&cache->partial, slab);
+	}
+
+	void *obj = slab->free;
+	slab->free = *(void **) obj;
+	slab->inuse++;
+	cache->active++;
+
+	if (slab->inuse == cache->objs_per_slab) {
+		/* slab 已满 */
+		slab_unlink(&cache->partial, slab);
+		slab_push(&cache->full, slab);
+	}
+
+	spinlock_release_irqrestore(&cache->lock, eflags);
+	return obj;
+}
+
+/*
+	@brief 将对象归还缓存。
+	@param cache 所属缓存
+	@param obj 待释放的对象
+*/
+void kmem_cache_free(KMEM_CACHE *cache, void *obj)
+{
+	if (!obj)
+		return;
+
+	slab_t *slab = SLAB_OF(obj);
+	if (slab->magic != SLAB_MAGIC || slab->cache != cache) {
+		debug("SLAB: Object %p does not belong to cache `%s`.\n", obj, cache ? cache->name : "(null)");
+		return;
+	}
+
+	uint32_t eflags = spinlock_acquire_irqsave(&cache->lock);
+
+	if (slab->inuse == cache->objs_per_slab) {
+		/* 已满的 slab 重新变为部分使用 */
+		slab_unlink(&cache->full, slab);
+		slab_push(&cache->partial, slab);
+	}
+
+	*(void **) obj = slab->free;
+	slab->free = obj;
+	slab->inuse--;
+	cache->active--;
+
+	if (slab->inuse == 0) {
+		/* 保留一个空 slab，其余归还内存池 */
+		slab_unlink(&cache->partial, slab);
+		if (!cache->empty)
+			cache->empty = slab;
+		else
+			slab_destroy(slab);
+	}
+
+	spinlock_release_irqrestore(&cache->lock, eflags);
+}
+
+/*
+	@brief 从尺寸类别缓存分配内存。
+	@param size 需要分配的字节数，不超过 `KMALLOC_MAX_SIZE`
+	@return 分配的内存指针，失败或尚未初始化时返回 NULL
+*/
+void *kmem_alloc(size_t size)
+{
+	if (size == 0 || size > KMALLOC_MAX_SIZE || !slab_map)
+		return NULL;
+
+	return kmem_cache_alloc(kmalloc_caches[kmalloc_index[(size - 1) / KMALLOC_MIN_SIZE]]);
+}
+
+/*
+	@brief 释放由 slab 分配的对象。
+	@param obj 待释放的对象
+*/
+void kmem_free(void *obj)
+{
+	if (obj)
+		kmem_cache_free(SLAB_OF(obj)->cache, obj);
+}
+
+/*
+	@brief 判断指针是否位于 slab 中。
+	@param ptr 待判断的指针
+	@return 位于 slab 中返回 true
+*/
+bool kmem_owns(const void *ptr)
+{
+	if (!slab_map || (uintptr_t) ptr < slab_map_base)
+		return false;
+
+	size_t index = ((uintptr_t) ptr - slab_map_base) / SLAB_SIZE;
+	if (index >= slab_map_pages)
+		return false;
+
+	return (slab_map[index / 32] >> (index % 32)) & 1;
+}
+
+/*
+	@brief 获取 slab 对象的可用大小。
+	@param obj 对象指针
+	@return 对象大小（字节）
+*/
+size_t kmem_object_size(const void *obj)
+{
+	return SLAB_OF(obj)->cache->size;
+}
@@ -0,0 +1,54 @@
+;
+;	core/switch.asm
+;
+
+section .text
+
+; void context_switch(uint32_t *prev_esp, uint32_t next_esp);
+global _context_switch
+_context_switch:
+	mov eax, [esp + 4]		; 保存当前栈指针的位置
+	mov edx, [esp + 8]		; 新任务的栈指针
+
+	; 保存当前任务的上下文
+	; 调用者保存的寄存器（eax、ecx、edx）已由编译器处理
+	pushfd
+	push ebp
+	push ebx
+	push esi
+	push edi
+	push fs
+	push gs
+
+	; 切换栈
+	mov [eax], esp
+	mov esp, edx
+
+	; 此时栈布局（与 task.c 中为新任务构造的初始栈一致）
+	; +--------------+
+	; |      gs      | <--- esp + 0
+	; +--------------+
+	; |      fs      | <--- esp + 4
+	; +--------------+
+	; |     edi      | <--- esp + 8
+	; +--------------+
+	; |     esi      | <--- esp + 12
+	; +--------------+
+	; |     ebx      | <--- esp + 16
+	; +--------------+
+	; |     ebp      | <--- esp + 20
+	; +--------------+
+	; |    eflags    | <--- esp + 24
+	; +--------------+
+	; |     eip      | <--- esp + 28
+	; +--------------+
+
+	; 恢复新任务的上下文；fs、gs 在 LDT 切换之后重新加载，以取得新任务的段描述符
+	pop gs
+	pop fs
+	pop edi
+	pop esi
+	pop ebx
+	pop ebp
+	popfd
+	ret
@@ -0,0 +1,250 @@
+/*
+	core/sync.c
+*/
+
+#include <ClassiX/debug.h>
+#include <ClassiX/io.h>
+#include <ClassiX/spinlock.h>
+#include <ClassiX/sync.h>
+#include <ClassiX/task.h>
+#include <ClassiX/typedef.h>
+
+/* 将任务移出其所在的等待队列 */
+static inline void wq_remove(WAIT_QUEUE *wq, TASK *task)
+{
+	if (task->wait_prev)
+		task->wait_prev->wait_next = task->wait_next;
+	else
+		wq->head = task->wait_next;
+	if (task->wait_next)
+		task->wait_next->wait_prev = task->wait_prev;
+	else
+		wq->tail = task->wait_prev;
+	task->wait_queue = NULL;
+}
+
+/*
+	@brief 初始化等待队列。
+	@param wq 等待队列
+*/
+void wait_queue_init(WAIT_QUEUE *wq)
+{
+	wq->head = NULL;
+	wq->tail = NULL;
+}
+
+/*
+	@brief 使当前任务在等待队列上休眠，直至被唤醒。
+	@param wq 等待队列
+	@param lock 保护等待条件的自旋锁，可为 NULL
+	@return true - 由 wait_queue_wake_one 或 wait_queue_wake_all 唤醒；false - 被其他途径唤醒
+	@note 须在关中断时调用，且调用者应已在关中断后检查过等待条件，以免错过唤醒。
+		  lock 不为 NULL 时在休眠前释放、唤醒后重新获取，期间中断保持关闭。返回时中断仍关闭。
+*/
+bool wait_queue_sleep(WAIT_QUEUE *wq, spinlock_t *lock)
+{
+	TASK *task = task_get_current();
+
+	/* 加入队尾 */
+	task->wait_queue = wq;
+	task->wait_next = NULL;
+	task->wait_prev = wq->tail;
+	if (wq->tail)
+		wq->tail->wait_next = task;
+	else
+		wq->head = task;
+	wq->tail = task;
+
+	if (lock)
+		spinlock_release(lock);
+	task_sleep(task);
+	if (lock)
+		spinlock_acquire(lock);
+
+	/* 仍在队列中，说明是被其他途径（如 task_register）唤醒的 */
+	if (task->wait_queue == wq) {
+		wq_remove(wq, task);
+		return false;
+	}
+	return true;
+}
+
+/*
+	@brief 唤醒等待队列中最早进入的任务。
+	@param wq 等待队列
+	@return 被唤醒的任务，队列为空时返回 NULL
+	@note 被唤醒的任务保持原有优先级；优先级高于当前任务时立即抢占。
+*/
+TASK *wait_queue_wake_one(WAIT_QUEUE *wq)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	TASK *task = wq->head;
+	if (task) {
+		wq_remove(wq, task);
+		task_register(task, task->priority);
+	}
+
+	store_eflags(eflags);
+	return task;
+}
+
+/*
+	@brief 按进入的先后顺序唤醒等待队列中的全部任务。
+	@param wq 等待队列
+	@return 被唤醒的任务数
+*/
+uint32_t wait_queue_wake_all(WAIT_QUEUE *wq)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	/* 只唤醒此刻已在队列中的任务：被唤醒的任务可能立即抢占并重新进入队列，不应被本次重复唤醒 */
+	uint32_t count = 0;
+	for (TASK *task = wq->head; task; task = task->wait_next)
+		count++;
+	for (uint32_t i = 0; i < count; i++)
+		wait_queue_wake_one(wq);
+
+	store_eflags(eflags);
+	return count;
+}
+
+/*
+	@brief 初始化互斥锁。
+	@param mutex 互斥锁
+*/
+void mutex_init(MUTEX *mutex)
+{
+	mutex->owner = NULL;
+	wait_queue_init(&mutex->waiters);
+}
+
+/*
+	@brief 获取互斥锁，已被持有时休眠等待。
+	@param mutex 互斥锁
+	@note 须在任务上下文中调用，不可递归获取。
+*/
+void mutex_lock(MUTEX *mutex)
+{
+	TASK *task = task_get_current();
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (!mutex->owner) {
+		mutex->owner = task;
+	} else {
+		if (mutex->owner == task)
+			debug("MUTEX: Task %p relocks mutex %p.\n", task, mutex);
+
+		/* 释放者直接将所有权移交给队首任务，被唤醒即已持有 */
+		while (!wait_queue_sleep(&mutex->waiters, NULL)) { }
+	}
+
+	store_eflags(eflags);
+}
+
+/*
+	@brief 尝试获取互斥锁，不休眠。
+	@param mutex 互斥锁
+	@return true - 获取成功；false - 已被持有
+*/
+bool mutex_trylock(MUTEX *mutex)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	bool acquired = !mutex->owner;
+	if (acquired)
+		mutex->owner = task_get_current();
+
+	store_eflags(eflags);
+	return acquired;
+}
+
+/*
+	@brief 释放互斥锁，有任务等待时将所有权移交给最早等待的任务。
+	@param mutex 互斥锁
+*/
+void mutex_unlock(MUTEX *mutex)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (mutex->owner != task_get_current())
+		debug("MUTEX: Mutex %p unlocked by non-owner.\n", mutex);
+
+	/* 先移交所有权再唤醒，被唤醒的任务抢占时即已持有 */
+	TASK *next = mutex->waiters.head;
+	mutex->owner = next;
+	if (next)
+		wait_queue_wake_one(&mutex->waiters);
+
+	store_eflags(eflags);
+}
+
+/*
+	@brief 初始化信号量。
+	@param sem 信号量
+	@param count 初始可用资源数
+*/
+void semaphore_init(SEMAPHORE *sem, uint32_t count)
+{
+	sem->count = count;
+	wait_queue_init(&sem->waiters);
+}
+
+/*
+	@brief 获取一个资源，没有可用资源时休眠等待。
+	@param sem 信号量
+	@note 须在任务上下文中调用。
+*/
+void semaphore_down(SEMAPHORE *sem)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (sem->count > 0) {
+		sem->count--;
+	} else {
+		/* 释放者将资源直接移交给队首任务，不经过计数 */
+		while (!wait_queue_sleep(&sem->waiters, NULL)) { }
+	}
+
+	store_eflags(eflags);
+}
+
+/*
+	@brief 尝试获取一个资源，不休眠。
+	@param sem 信号量
+	@return true - 获取成功；false - 没有可用资源
+*/
+bool semaphore_trydown(SEMAPHORE *sem)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	bool acquired = sem->count > 0;
+	if (acquired)
+		sem->count--;
+
+	store_eflags(eflags);
+	return acquired;
+}
+
+/*
+	@brief 归还一个资源，有任务等待时移交给最早等待的任务。
+	@param sem 信号量
+	@note 可在中断处理程序中调用。
+*/
+void semaphore_up(SEMAPHORE *sem)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (!wait_queue_wake_one(&sem->waiters))
+		sem->count++;
+
+	store_eflags(eflags);
+}
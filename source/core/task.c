@@ -2,6 +2,7 @@
 	core/task.c
 */
 
+#include <ClassiX/cpu.h>
 #include <ClassiX/debug.h>
 #include <ClassiX/fifo.h>
 #include <ClassiX/interrupt.h>
@@ -13,23 +14,304 @@
 
 #include <string.h>
 
+extern void context_switch(uint32_t *prev_esp, uint32_t next_esp);
+
+TSS g_tss;										/* 唯一的任务状态段，仅提供特权级切换时的内核栈 */
+TASK *g_fpu_owner = NULL;						/* FPU 寄存器中现有状态所属的任务 */
+TASK_STATS g_task_stats;						/* 任务切换统计 */
 volatile uint64_t next_schedule_tick;			/* 下一次进行任务调度的系统滴答数 */
 
 static uint32_t ticks_per_priority_unit = 10;	/* 每单位优先级对应的系统滴答数 */
 static bool multitasking_initialized = false;	/* 多任务是否已初始化 */
+static uint32_t preempt_disabled = 0;			/* 禁止抢占的嵌套深度 */
+static bool preempt_pending = false;			/* 禁止抢占期间有更高优先级的任务就绪 */
+static TASK *ldt_owner = NULL;					/* LDT 描述符当前指向的任务 */
+static uint64_t switch_tsc = 0;					/* 当前任务开始运行的 TSC 时刻，0 表示尚未开始计时 */
+static uint64_t rt_charge_ns = 0;				/* 上一次结算实时预算的时刻（纳秒） */
+static uint32_t rt_utilization = 0;				/* 全部实时任务预留的处理器份额（千分比） */
+
+/* 内核线程回收 */
+static TASK *kthread_zombies = NULL;			/* 已退出、待回收的内核线程，经 rq_next 串接 */
+static void *kstack_cache[KTHREAD_STACK_CACHE];	/* 已回收、可直接复用的内核线程栈 */
+static uint32_t kstack_cached = 0;				/* 缓存的栈数 */
 
 static struct TASK_MANAGER {
-	uint32_t running;		/* 正在运行的任务数量 */
-	uint32_t now;			/* 当前任务 */
-	TASK *tasks[MAX_TASKS];
-	TASK tasks0[MAX_TASKS];
+	TASK *current;								/* 当前任务 */
+	uint32_t ready_bitmap;						/* 非空运行队列位图，第 i 位对应优先级 i */
+	TASK *run_queues[TASK_PRIORITY_LEVELS];		/* 各优先级的运行队列（环形链表）头 */
+	TASK *rt_queue;								/* 有预算的实时任务，按截止时刻升序经 rq_next 串接 */
+	TASK *tasks_head;							/* 全部任务对象，按创建顺序经 all_next 串接 */
+	TASK *tasks_tail;
+	TASK *free_tasks;							/* 已回收、可复用的任务对象，经 rq_next 串接 */
+	int32_t next_id;							/* 下一个新建任务对象的编号 */
 } *task_manager;
 
+/* 将实时任务按截止时刻插入实时运行队列，截止时刻相同的排在已有任务之后 */
+static inline void rt_enqueue(TASK *task)
+{
+	TASK *prev = NULL, *next = task_manager->rt_queue;
+	while (next && next->rt_deadline <= task->rt_deadline) {
+		prev = next;
+		next = next->rq_next;
+	}
+
+	task->rq_prev = prev;
+	task->rq_next = next;
+	if (next)
+		next->rq_prev = task;
+	if (prev)
+		prev->rq_next = task;
+	else
+		task_manager->rt_queue = task;
+	task->rt_queued = true;
+}
+
+/* 将任务移出实时运行队列 */
+static inline void rt_dequeue(TASK *task)
+{
+	if (task->rq_prev)
+		task->rq_prev->rq_next = task->rq_next;
+	else
+		task_manager->rt_queue = task->rq_next;
+	if (task->rq_next)
+		task->rq_next->rq_prev = task->rq_prev;
+	task->rt_queued = false;
+}
+
+/* 将任务加入其运行队列：有预算的实时任务进入实时运行队列，其余加入其优先级运行队列的队尾 */
+static inline void rq_enqueue(TASK *task)
+{
+	if (task->rt_period && !task->rt_throttled) {
+		rt_enqueue(task);
+		return;
+	}
+
+	TASK **head = &task_manager->run_queues[task->priority];
+	if (*head) {
+		task->rq_prev = (*head)->rq_prev;
+		task->rq_next = *head;
+		(*head)->rq_prev->rq_next = task;
+		(*head)->rq_prev = task;
+	} else {
+		task->rq_prev = task->rq_next = task;
+		*head = task;
+		task_manager->ready_bitmap |= 1u << task->priority;
+	}
+}
+
+/* 将任务移出其运行队列 */
+static inline void rq_dequeue(TASK *task)
+{
+	if (task->rt_queued) {
+		rt_dequeue(task);
+		return;
+	}
+
+	TASK **head = &task_manager->run_queues[task->priority];
+	if (task->rq_next == task) {
+		*head = NULL;
+		task_manager->ready_bitmap &= ~(1u << task->priority);
+	} else {
+		task->rq_prev->rq_next = task->rq_next;
+		task->rq_next->rq_prev = task->rq_prev;
+		if (*head == task)
+			*head = task->rq_next;
+	}
+}
+
+/* 取出截止时刻最早的实时任务，没有时取最高优先级运行队列的队首任务；空闲任务从不休眠，故总能找到 */
+static inline TASK *rq_pick(void)
+{
+	if (task_manager->rt_queue)
+		return task_manager->rt_queue;
+	return task_manager->run_queues[31 - __builtin_clz(task_manager->ready_bitmap)];
+}
+
+/* 按任务的初始寄存器构造首次切换所需的栈，其布局与 context_switch 保存的一致 */
+static void task_init_context(TASK *task)
+{
+	uint32_t *sp = (uint32_t *) task->tss.esp;
+	*--sp = task->tss.eip;		/* 返回地址即入口点 */
+	*--sp = task->tss.eflags;
+	*--sp = task->tss.ebp;
+	*--sp = task->tss.ebx;
+	*--sp = task->tss.esi;
+	*--sp = task->tss.edi;
+	*--sp = task->tss.fs;
+	*--sp = task->tss.gs;
+	task->context_esp = (uint32_t) sp;
+}
+
+/* 任务 a 是否应抢占当前任务 b：有预算的实时任务先于普通任务，实时任务间截止时刻早者优先，普通任务间优先级高者优先 */
+static inline bool task_preempts(const TASK *a, const TASK *b)
+{
+	if (a->rt_queued || b->rt_queued)
+		return a->rt_queued && (!b->rt_queued || a->rt_deadline < b->rt_deadline);
+	return a->priority > b->priority;
+}
+
+/* 实时任务开始新的周期：补足预算，截止时刻为一个周期之后 */
+static inline void rt_new_period(TASK *task)
+{
+	task->rt_deadline = get_system_ticks() + task->rt_period;
+	task->rt_runtime = task->rt_budget;
+	task->rt_throttled = false;
+}
+
+/* 为预算用尽的就绪实时任务启动单次定时器，在截止时刻补足预算；须在关中断时调用 */
+static void rt_arm(TASK *task)
+{
+	if (task->rt_timer->state == TIMER_ACTIVE)
+		return;
+	uint64_t now = get_system_ticks();
+	timer_start(task->rt_timer, task->rt_deadline > now ? task->rt_deadline - now : 1, 0);
+}
+
+/* 停止补足预算的定时器，休眠的任务在唤醒时由 rt_wake 补足；须在关中断时调用 */
+static inline void rt_disarm(TASK *task)
+{
+	if (task->rt_period && task->rt_timer->state == TIMER_ACTIVE)
+		timer_stop(task->rt_timer);
+}
+
+/* 实时任务被唤醒：截止时刻已过时开始新的周期，否则沿用本周期剩余的预算；须在关中断时调用 */
+static void rt_wake(TASK *task)
+{
+	if (!task->rt_period)
+		return;
+	if (get_system_ticks() >= task->rt_deadline)
+		rt_new_period(task);
+	else if (task->rt_throttled)
+		rt_arm(task);
+}
+
+/* 结算任务自上次结算以来消耗的实时预算；用尽时任务移入其优先级运行队列，直至截止时刻补足预算；须在关中断时调用 */
+static void rt_charge(TASK *task)
+{
+	uint64_t now = get_system_nanoseconds();
+	uint64_t used = now - rt_charge_ns;
+	rt_charge_ns = now;
+
+	if (!task->rt_period || task->rt_throttled)
+		return;
+	if (used < task->rt_runtime) {
+		task->rt_runtime -= (uint32_t) used;
+		return;
+	}
+
+	task->rt_runtime = 0;
+	task->rt_throttled = true;
+	g_task_stats.rt_throttles++;
+	if (task->rt_queued) {
+		rt_dequeue(task);
+		rq_enqueue(task);
+	}
+	if (task->state == TASK_RUNNING)
+		rt_arm(task);
+}
+
+/* 记录一次自唤醒至开始运行的延迟 */
+static void task_record_latency(TASK *task, uint64_t cycles)
+{
+	uint32_t latency = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t) cycles;
+	if (latency > task->wake_latency_max)
+		task->wake_latency_max = latency;
+
+	/* 按微秒数的二进制位数分桶，避免 64 位除法 */
+	uint32_t us = latency / ((tsc_khz + 500) / 1000);
+	uint32_t bucket = us ? 32 - __builtin_clz(us) : 0;
+	if (bucket >= TASK_LATENCY_BUCKETS)
+		bucket = TASK_LATENCY_BUCKETS - 1;
+	g_task_stats.wake_latency[bucket]++;
+}
+
+/* 切换到指定的任务，并为其分配新的时间片；须在关中断时调用 */
+static void task_switch(TASK *next)
+{
+	TASK *prev = task_manager->current;
+
+	/* 离开空闲任务前补记无滴答模式期间的滴答 */
+	pit_tickless_exit();
+	rt_charge(prev);
+
+	/* 实时任务的时间片为其剩余预算，到期时由 task_schedule 结算 */
+	if (next->rt_queued)
+		next_schedule_tick = get_system_ticks() + ns_to_ticks(next->rt_runtime) + 1;
+	else
+		next_schedule_tick = get_system_ticks() + next->priority * ticks_per_priority_unit;
+	if (next == prev)
+		return;
+
+	/* 将自上次切换以来的时间计入上一个任务；TSC 在 init_pit 校准后才可用 */
+	if (tsc_khz) {
+		uint64_t now = rdtsc();
+		if (switch_tsc)
+			prev->run_cycles += now - switch_tsc;
+		switch_tsc = now;
+		if (next->wake_tsc) {
+			task_record_latency(next, now - next->wake_tsc);
+			next->wake_tsc = 0;
+		}
+	}
+	if (prev->state == TASK_RUNNING)
+		prev->involuntary_switches++;
+	else
+		prev->voluntary_switches++;
+
+	if (!next->context_esp)
+		task_init_context(next);
+
+	/* 特权级切换使用的内核栈随任务保存与恢复 */
+	prev->tss.esp0 = g_tss.esp0;
+	prev->tss.ss0 = g_tss.ss0;
+	g_tss.esp0 = next->tss.esp0;
+	g_tss.ss0 = next->tss.ss0;
+
+	/* 内核任务不使用 LDT，只在切换到运行应用程序的任务时改写并重新加载 LDT 描述符 */
+	if (next->tss.ldtr && next != ldt_owner)
+		task_load_ldt(next);
+
+	/* 新任务不持有 FPU 时置位 CR0.TS，待其首次使用 FPU 时由 #NM 惰性切换 */
+	CR0 cr0 = { .value = load_cr0() };
+	uint32_t ts = next != g_fpu_owner;
+	if (cr0.ts != ts) {
+		cr0.ts = ts;
+		store_cr0(cr0.value);
+	}
+
+	g_task_stats.switches++;
+	task_manager->current = next;
+	context_switch(&prev->context_esp, next->context_esp);
+}
+
+/* 空闲任务最迟须被唤醒的时刻：最近的定时器，或同为空闲优先级的其他任务的调度时刻 */
+static uint64_t idle_deadline(void)
+{
+	uint64_t deadline = timer_next_expiry();
+	TASK *current = task_manager->current;
+	if (current->rq_next != current && next_schedule_tick < deadline)
+		deadline = next_schedule_tick;
+	return deadline;
+}
+
 /* 空闲任务入口点 */
-static void task_idle_entry(void)
+static void task_idle_entry(void *arg)
 {
-	for(;;)
-		hlt();
+	for(;;) {
+		/* 归还中断上下文中延迟释放的内存与已退出的内核线程，并在空闲时补充预清零内存块 */
+		kfree_drain();
+		kthread_reap();
+		if (kzero_refill())
+			continue;
+
+		/* 停止周期中断直至最近的截止时刻；更高优先级的任务被唤醒时立即抢占空闲任务 */
+		cli();
+		pit_tickless_enter(idle_deadline());
+		sti_hlt();
+		cli();
+		pit_tickless_exit();
+		sti();
+	}
 }
 
 /*
@@ -38,51 +320,39 @@ static void task_idle_entry(void)
 */
 TASK *init_multitasking(void)
 {
-	TASK *ktask, *idle;
+	TASK *ktask;
 
 	task_manager = kmalloc(sizeof(struct TASK_MANAGER));
 	if (!task_manager) return NULL;
 
-	for (int32_t i = 0; i < MAX_TASKS; i++) {
-		task_manager->tasks0[i].state = TASK_FREE;
-		task_manager->tasks0[i].selector = (TASK_GDT0 + i) * 8;
-		task_manager->tasks0[i].tss.ldtr = (TASK_GDT0 + i + MAX_TASKS) * 8;
+	task_manager->tasks_head = NULL;
+	task_manager->tasks_tail = NULL;
+	task_manager->free_tasks = NULL;
+	task_manager->next_id = 1;
+	task_manager->ready_bitmap = 0;
+	task_manager->rt_queue = NULL;
+	for (int32_t i = 0; i < TASK_PRIORITY_LEVELS; i++)
+		task_manager->run_queues[i] = NULL;
 
-		memset(&task_manager->tasks0[i].ldt, 0, sizeof(task_manager->tasks0[i].ldt));
-
-		gdt_set_gate(TASK_GDT0 + i,
-			(uint32_t) &task_manager->tasks0[i].tss,
-			sizeof(TSS) - 1,
-			AR_TSS32 & 0xff,
-			AR_TSS32 >> 8);
-		gdt_set_gate(TASK_GDT0 + i + MAX_TASKS,
-			(uint32_t) &task_manager->tasks0[i].ldt,
-			sizeof(task_manager->tasks0[i].ldt) - 1,
-			AR_LDT & 0xff,
-			AR_LDT >> 8);
-
-		task_manager->tasks0[i].argc = -1;
-		task_manager->tasks0[i].argv = NULL;
-	}
+	/* 任务切换由软件完成，TSS 仅用于由用户态进入内核时加载 ss0:esp0 */
+	memset(&g_tss, 0, sizeof(TSS));
+	g_tss.ss0 = 0x10;
+	g_tss.iomap = 0x40000000;
+	gdt_set_gate(TASK_TSS_GDT, (uint32_t) &g_tss, sizeof(TSS) - 1, AR_TSS32 & 0xff, AR_TSS32 >> 8);
+	load_tr(TASK_TSS_GDT * 8);
 
 	ktask = task_alloc();
 	ktask->state = TASK_RUNNING;
 	ktask->priority = PRIORITY_HIGH;
-	task_manager->running = 1;
-	task_manager->now = 0;
-	task_manager->tasks[0] = ktask;
-	load_tr(ktask->selector);
-
-	idle = task_alloc();
-	idle->tss.esp = (uint32_t) kmalloc(DEFAULT_USER_STACK) + DEFAULT_USER_STACK;
-	idle->tss.eip = (uint32_t) &task_idle_entry;
-	idle->tss.es = 0x10;
-	idle->tss.cs = 0x08;
-	idle->tss.ss = 0x10;
-	idle->tss.ds = 0x10;
-	idle->tss.fs = 0x10;
-	idle->tss.gs = 0x10;
-	task_register(idle, PRIORITY_IDLE);
+	rq_enqueue(ktask);
+	task_manager->current = ktask;
+	load_ldtr(0);
+
+	/* init_fpu 已在内核任务中初始化 FPU */
+	ktask->fpu_used = true;
+	g_fpu_owner = ktask;
+
+	kthread_create(task_idle_entry, NULL, PRIORITY_IDLE);
 
 	ticks_per_priority_unit = (pit_frequency * TIME_SLICE_BASE_PER_PRIORITY_MS) / 1000;
 	next_schedule_tick = get_system_ticks() + ktask->priority * ticks_per_priority_unit;
@@ -92,113 +362,516 @@ TASK *init_multitasking(void)
 	return ktask;
 }
 
+/* 新建一个任务对象，加入全部任务链表；须在关中断时调用 */
+static TASK *task_new(void)
+{
+	/* TASK 中的 FXSAVE 区域要求 16 字节对齐，内存池的块天然满足；任务对象不属于任何任务，不计入分配域 */
+	TASK *task = memory_alloc_irqsave(&g_mp, sizeof(TASK), NULL);
+	if (!task)
+		return NULL;
+
+	task->id = task_manager->next_id++;
+	memset(&task->ldt, 0, sizeof(task->ldt));
+	task->argc = -1;
+	task->argv = NULL;
+
+	task->all_next = NULL;
+	if (task_manager->tasks_tail)
+		task_manager->tasks_tail->all_next = task;
+	else
+		task_manager->tasks_head = task;
+	task_manager->tasks_tail = task;
+
+	g_task_stats.task_objects++;
+	return task;
+}
+
+/* 将任务对象放回空闲链表，供 task_alloc 复用；须在关中断时调用 */
+static void task_free(TASK *task)
+{
+	task->state = TASK_FREE;
+	task->rq_next = task_manager->free_tasks;
+	task_manager->free_tasks = task;
+}
+
 /*
 	@brief 获取一个任务。
-	@return 指向任务的指针
-	@note 应自行设置入口点和栈指针。
+	@return 指向任务的指针，内存不足时返回 NULL
+	@note 优先复用已回收的任务对象，没有时新建。应自行设置入口点和栈指针。
 */
 TASK *task_alloc(void)
 {
-	TASK *task;
-	for (int32_t i = 0; i < MAX_TASKS; i++) {
-		if (task_manager->tasks0[i].state == TASK_FREE) {
-			task = &task_manager->tasks0[i];
-
-			task->state = TASK_USED;
-			task->tss.eflags = 0x00000202;
-			task->tss.eax = 0;
-			task->tss.ecx = 0;
-			task->tss.edx = 0;
-			task->tss.ebx = 0;
-			task->tss.ebp = 0;
-			task->tss.esi = 0;
-			task->tss.edi = 0;
-			task->tss.es = 0;
-			task->tss.ds = 0;
-			task->tss.fs = 0;
-			task->tss.gs = 0;
-			task->tss.iomap = 0x40000000;
-
-			debug("TASK: Allocated task %p.\n", task);
-			return task;
-		}
+	uint32_t eflags = load_eflags();
+	cli();
+
+	TASK *task = task_manager->free_tasks;
+	if (task)
+		task_manager->free_tasks = task->rq_next;
+	else
+		task = task_new();
+	if (task)
+		task->state = TASK_USED;
+
+	store_eflags(eflags);
+
+	if (!task) {
+		debug("TASK: Failed to allocate free task.\n");
+		return NULL; /* 内存不足 */
 	}
 
-	debug("TASK: Failed to allocate free task.\n");
-	return NULL; /* 无空闲任务 */
+	task->tss.eflags = 0x00000202;
+	task->tss.eax = 0;
+	task->tss.ecx = 0;
+	task->tss.edx = 0;
+	task->tss.ebx = 0;
+	task->tss.ebp = 0;
+	task->tss.esi = 0;
+	task->tss.edi = 0;
+	task->tss.es = 0;
+	task->tss.ds = 0;
+	task->tss.fs = 0;
+	task->tss.gs = 0;
+	task->tss.ldtr = 0;
+	task->tss.iomap = 0x40000000;
+	task->context_esp = 0;
+	task->sleep_timer = NULL;
+	task->wait_queue = NULL;
+	task->arena = NULL;
+	task->mem_bytes = 0;
+	task->kstack = NULL;
+	task->run_cycles = 0;
+	task->wake_tsc = 0;
+	task->wake_latency_max = 0;
+	task->voluntary_switches = 0;
+	task->involuntary_switches = 0;
+	task->rt_period = 0;
+	task->rt_util = 0;
+	task->rt_throttled = false;
+	task->rt_queued = false;
+	task->rt_timer = NULL;
+	task->fpu_used = false;
+
+	debug("TASK: Allocated task %p.\n", task);
+	return task;
+}
+
+/*
+	@brief 将 GDT 中的 LDT 描述符指向指定任务的 LDT 并加载。
+	@param task 运行应用程序的任务
+	@note 所有任务共用一个 LDT 描述符，任务切换时按需改写；修改任务的 LDT 后须重新调用。
+*/
+void task_load_ldt(TASK *task)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	task->tss.ldtr = TASK_LDT_GDT * 8;
+	gdt_set_gate(TASK_LDT_GDT, (uint32_t) &task->ldt, sizeof(task->ldt) - 1, AR_LDT & 0xff, AR_LDT >> 8);
+	load_ldtr(task->tss.ldtr);
+	ldt_owner = task;
+
+	store_eflags(eflags);
+}
+
+/* 就绪任务中有应抢占当前任务的任务时立即切换，禁止抢占期间推迟到 task_preempt_enable；须在关中断时调用 */
+static void task_check_preempt(void)
+{
+	TASK *next = rq_pick();
+	if (task_preempts(next, task_manager->current)) {
+		if (preempt_disabled)
+			preempt_pending = true;
+		else
+			task_switch(next);
+	}
 }
 
 /*
 	@brief 注册指定的任务。
 	@param task 待注册的任务
 	@param priority 任务优先级
-	@note 亦可用于唤醒休眠的任务。
+	@note 亦可用于唤醒休眠的任务或调整任务优先级。被唤醒的任务优先级高于当前任务，或为截止时刻更早的实时任务时立即抢占。
 */
 void task_register(TASK *task, TASK_PRIORITY priority)
 {
-	task->priority = priority;
-	if (task->state != TASK_RUNNING) {
-		/* 避免重复注册任务 */
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (task->state == TASK_RUNNING) {
+		/* 已在运行队列中，仅调整优先级 */
+		if (task->priority != priority) {
+			rq_dequeue(task);
+			task->priority = priority;
+			rq_enqueue(task);
+		}
+	} else {
+		task->priority = priority;
 		task->state = TASK_RUNNING;
-		task_manager->tasks[task_manager->running++] = task;
-		if (priority > task_manager->tasks[task_manager->now]->priority) {
-			/* 新任务优先级高于当前任务，立即切换 */
-			for (int32_t i = 0; i < (signed)task_manager->running; i++) {
-				if (task_manager->tasks[i] == task) {
-					task_manager->now = i;
-					break;
-				}
-			}
-			farjmp(0, task_manager->tasks[task_manager->now]->selector);
+		task->wake_tsc = tsc_khz ? rdtsc() : 0;
+		rt_wake(task);
+		rq_enqueue(task);
+	}
+
+	task_check_preempt();
+	store_eflags(eflags);
+}
+
+/* 预算用尽的就绪实时任务到达截止时刻：开始新的周期 */
+static void task_rt_replenish(void *arg)
+{
+	TASK *task = arg;
+	uint32_t eflags = load_eflags();
+	cli();
+
+	/* 到期前任务可能已取消预留，或已休眠后被唤醒并由 rt_wake 补足 */
+	if (task->rt_period && task->rt_throttled) {
+		rt_charge(task_manager->current);	/* 当前任务此前的消耗计入上一个周期 */
+		rt_new_period(task);
+		if (task->state == TASK_RUNNING) {
+			rq_dequeue(task);
+			rq_enqueue(task);
 		}
+		task_check_preempt();
+	}
+
+	store_eflags(eflags);
+}
+
+/* 取消任务的实时预留，恢复为普通任务；须在关中断时调用 */
+static void task_clear_realtime(TASK *task)
+{
+	if (!task->rt_period)
+		return;
+
+	bool running = task->state == TASK_RUNNING;
+	if (running)
+		rq_dequeue(task);
+	rt_utilization -= task->rt_util;
+	task->rt_util = 0;
+	task->rt_period = 0;
+	task->rt_throttled = false;
+	if (running)
+		rq_enqueue(task);
+
+	timer_delete(task->rt_timer);
+	task->rt_timer = NULL;
+}
+
+/*
+	@brief 为任务预留处理器时间：每 period_ms 毫秒保证 budget_us 微秒。
+	@param task 任务
+	@param period_ms 预留周期（毫秒），0 表示取消预留
+	@param budget_us 每个周期的预算（微秒），不超过周期
+	@return 成功返回 0；参数无效、无法创建定时器或全部实时任务的份额将超过 TASK_RT_UTIL_MAX 时返回 -1
+	@note 有预算的实时任务先于任何普通任务运行，彼此按最早截止时刻优先（EDF）调度，截止时刻即本周期结束。
+		  预算用尽后任务按其优先级与普通任务轮转，直至截止时刻补足预算。周期不由定时器驱动：
+		  任务在截止时刻之后被唤醒时开始新的周期，只有就绪且预算用尽时才启动单次定时器，空闲时不产生中断。
+		  须在 init_pit 之后调用。
+*/
+int32_t task_set_realtime(TASK *task, uint32_t period_ms, uint32_t budget_us)
+{
+	uint32_t eflags = load_eflags();
+
+	if (period_ms == 0) {
+		cli();
+		task_clear_realtime(task);
+		store_eflags(eflags);
+		return 0;
+	}
+
+	if (period_ms > TASK_RT_PERIOD_MAX_MS || budget_us == 0 || budget_us > period_ms * 1000)
+		return -1;
+
+	uint32_t period = period_ms * pit_frequency / 1000;
+	if (period == 0)
+		period = 1;
+	uint32_t util = (budget_us + period_ms - 1) / period_ms;
+
+	TIMER *timer = task->rt_timer;
+	if (!timer && !(timer = timer_create(task_rt_replenish, task, 0)))
+		return -1;
+
+	cli();
+
+	/* 准入控制：EDF 在总份额不超过 100% 时可满足全部截止时刻，另留出余量给普通任务 */
+	if (rt_utilization - task->rt_util + util > TASK_RT_UTIL_MAX) {
+		if (!task->rt_timer)
+			timer_delete(timer);
+		store_eflags(eflags);
+		debug("TASK: Real-time reservation for task %d rejected (%u + %u permille).\n", TID(task), rt_utilization - task->rt_util, util);
+		return -1;
 	}
+
+	bool running = task->state == TASK_RUNNING;
+	if (running)
+		rq_dequeue(task);
+	rt_charge(task_manager->current);
+	rt_utilization += util - task->rt_util;
+	task->rt_util = util;
+	task->rt_timer = timer;
+	task->rt_period = period;
+	task->rt_budget = budget_us * 1000;
+	rt_disarm(task);
+	rt_new_period(task);
+	if (running)
+		rq_enqueue(task);
+
+	task_check_preempt();
+	store_eflags(eflags);
+	return 0;
+}
+
+/*
+	@brief 禁止抢占：此后唤醒的更高优先级任务推迟到 task_preempt_enable 时再运行。
+	@note 可嵌套。禁止抢占期间当前任务不可休眠。
+*/
+void task_preempt_disable(void)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+	preempt_disabled++;
+	store_eflags(eflags);
+}
+
+/*
+	@brief 恢复抢占，期间有更高优先级的任务就绪时立即切换。
+*/
+void task_preempt_enable(void)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (--preempt_disabled == 0 && preempt_pending) {
+		preempt_pending = false;
+		task_check_preempt();
+	}
+
+	store_eflags(eflags);
 }
 
 /*
 	@brief 任务调度器。
+	@note 由 PIT 中断在当前任务的时间片用完时调用，在最高优先级的就绪任务间轮转；实时任务按截止时刻调度。
 */
 void task_schedule(void)
 {
-	const TASK *task;
-	task_manager->now++;
-	if (task_manager->now >= task_manager->running)
-		task_manager->now = 0;
+	TASK *current = task_manager->current;
 
-	task = task_manager->tasks[task_manager->now];
-	next_schedule_tick += task->priority * ticks_per_priority_unit;
+	/* 先结算实时预算，用尽的实时任务在此让出 */
+	rt_charge(current);
+
+	/* 当前任务移至同优先级队列的队尾 */
+	if (current->state == TASK_RUNNING) {
+		rq_dequeue(current);
+		rq_enqueue(current);
+	}
 
-	/* 跳转至对应任务 */
-	if (task_manager->running >= 2)
-		farjmp(0, task->selector);
+	task_switch(rq_pick());
 }
 
 /*
 	@brief 使指定的任务休眠。
-	@return 指向任务的指针
+	@param task 待休眠的任务
+	@note 使当前任务休眠时切换到下一个就绪任务。
 */
 void task_sleep(TASK *task)
 {
-	bool ts = false;
+	uint32_t eflags = load_eflags();
+	cli();
 
 	if (task->state == TASK_RUNNING) {
 		/* 指定的任务正在运行 */
-		if (task == task_manager->tasks[task_manager->now])
-			ts = true; /* 使自己休眠（Yield），需要进行任务切换 */
-
-		for (int32_t i = 0; i < (signed) task_manager->running; i++)
-			if (task == task_manager->tasks[i]) {
-				task_manager->running--;
-				if (i < (signed) task_manager->now) task_manager->now--;
-				task->state = TASK_USED;
-				for (; i < (signed) task_manager->running; i++)
-					task_manager->tasks[i] = task_manager->tasks[i + 1];
+		rq_dequeue(task);
+		task->state = TASK_USED;
+		task->wake_tsc = 0;
+		rt_disarm(task);
+		if (task == task_manager->current)
+			task_switch(rq_pick()); /* 使自己休眠（Yield），需要进行任务切换 */
+	}
+
+	store_eflags(eflags);
+}
+
+/* 定时休眠到期：删除唤醒定时器并唤醒任务；在工作线程中执行，任务可能已被其他事件唤醒并删除了定时器 */
+static void task_sleep_timeout(void *arg)
+{
+	TASK *task = arg;
+	uint32_t eflags = load_eflags();
+	cli();
+
+	if (task->sleep_timer) {
+		timer_delete(task->sleep_timer);
+		task->sleep_timer = NULL;
+		task_register(task, task->priority);
+	}
+
+	store_eflags(eflags);
+}
+
+/*
+	@brief 使当前任务休眠至指定的系统滴答。
+	@param tick 唤醒时刻（系统滴答数）
+	@note 休眠期间让出处理器，由定时器在工作线程中经 task_register 唤醒；被其他事件提前唤醒时继续休眠。
+		  关中断或多任务尚未初始化时滴答不会前进，退化为忙等待。工作线程执行的函数不可调用。
+*/
+void task_sleep_until(uint64_t tick)
+{
+	TASK *task = task_get_current();
+	uint32_t eflags = load_eflags();
+
+	if (!task || !(eflags & EFLAGS_IF)) {
+		for (uint64_t now = get_system_ticks(); now < tick; now++)
+			udelay(1000000 / pit_frequency);
+		return;
+	}
+
+	cli();
+	uint64_t start = get_system_ticks();
+	while (get_system_ticks() < tick) {
+		if (!task->sleep_timer) {
+			task->sleep_timer = timer_create(task_sleep_timeout, task, TIMER_FLAG_WORKER);
+			if (!task->sleep_timer) {
+				/* 无法创建定时器，只能开中断忙等待 */
+				store_eflags(eflags);
+				while (get_system_ticks() < tick)
+					pause();
+				return;
 			}
+			timer_start(task->sleep_timer, tick - get_system_ticks(), 0);
+		}
+		task_sleep(task);
+	}
+
+	/* 无滴答模式补记滴答后，定时器可能尚未处理即已到期 */
+	if (task->sleep_timer) {
+		timer_delete(task->sleep_timer);
+		task->sleep_timer = NULL;
+	}
+
+	g_task_stats.timed_sleeps++;
+	g_task_stats.slept_ticks += get_system_ticks() - start;
+	store_eflags(eflags);
+}
+
+/*
+	@brief 使当前任务休眠指定的时长。
+	@param ms 休眠时长（毫秒）
+	@note 实际休眠时长不短于 ms 毫秒，最多多出一个滴答。
+*/
+void task_sleep_ms(uint32_t ms)
+{
+	uint64_t ticks = ((uint64_t) ms * pit_frequency + 999) / 1000;
+	task_sleep_until(get_system_ticks() + ticks + 1);
+}
+
+/*
+	@brief 创建内核线程并使其就绪。
+	@param entry 线程入口点，返回时等同于调用 kthread_exit
+	@param arg 传递给入口点的参数
+	@param priority 线程优先级
+	@return 新线程，失败返回 NULL
+	@note 栈优先取自已退出线程的缓存。优先级高于当前任务时，新线程在本函数返回前即开始运行。
+*/
+TASK *kthread_create(KTHREAD_ENTRY entry, void *arg, TASK_PRIORITY priority)
+{
+	kthread_reap();
+
+	/* 优先复用缓存的栈；栈不属于任何任务或分配域，不会随创建者的程序一同回收 */
+	void *stack = NULL;
+	uint32_t eflags = load_eflags();
+	cli();
+	if (kstack_cached > 0) {
+		stack = kstack_cache[--kstack_cached];
+		g_task_stats.kstacks_reused++;
+	}
+	store_eflags(eflags);
 
-		if (task_manager->now >= task_manager->running)
-			task_manager->now = 0;
-		if (ts)
-			farjmp(0, task_manager->tasks[task_manager->now]->selector);
+	if (!stack && !(stack = memory_alloc_irqsave(&g_mp, KTHREAD_STACK_SIZE, NULL))) {
+		debug("TASK: Failed to allocate kernel thread stack.\n");
+		return NULL;
 	}
+
+	TASK *task = task_alloc();
+	if (!task) {
+		memory_free_irqsave(&g_mp, stack);
+		return NULL;
+	}
+
+	/* 入口点的返回地址为 kthread_exit，参数位于其上方 */
+	uint32_t *sp = (uint32_t *) ((uint8_t *) stack + KTHREAD_STACK_SIZE);
+	*--sp = (uint32_t) arg;
+	*--sp = (uint32_t) &kthread_exit;
+
+	task->kstack = stack;
+	task->tss.esp = (uint32_t) sp;
+	task->tss.eip = (uint32_t) entry;
+	task->tss.es = 0x10;
+	task->tss.cs = 0x08;
+	task->tss.ss = 0x10;
+	task->tss.ds = 0x10;
+	task->tss.fs = 0x10;
+	task->tss.gs = 0x10;
+
+	g_task_stats.kthreads_created++;
+	task_register(task, priority);
+	return task;
+}
+
+/*
+	@brief 结束当前内核线程。
+	@note 线程移出运行队列后挂入待回收链表，其栈与任务槽由 kthread_reap 在其他任务中回收。
+*/
+void kthread_exit(void)
+{
+	TASK *task = task_manager->current;
+
+	cli();
+	task->rq_next = kthread_zombies;
+	kthread_zombies = task;
+	debug("TASK: Kernel thread %p exited.\n", task);
+
+	/* 已退出的线程即使被意外唤醒也立即重新休眠 */
+	for (;;)
+		task_sleep(task);
+}
+
+/*
+	@brief 回收已退出的内核线程：栈放回缓存（缓存已满时释放），任务槽标记为空闲。
+	@note 由空闲任务与 kthread_create 调用。
+*/
+void kthread_reap(void)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	TASK **link = &kthread_zombies;
+	while (*link) {
+		TASK *task = *link;
+
+		/* 被意外唤醒、尚在运行队列中的线程待其再次休眠后回收 */
+		if (task->state == TASK_RUNNING || task == task_manager->current) {
+			link = &task->rq_next;
+			continue;
+		}
+		*link = task->rq_next;
+
+		task_clear_realtime(task);
+		void *stack = task->kstack;
+		task->kstack = NULL;
+		if (g_fpu_owner == task)
+			g_fpu_owner = NULL;
+		task_free(task);
+		g_task_stats.kthreads_reaped++;
+
+		if (kstack_cached < KTHREAD_STACK_CACHE) {
+			kstack_cache[kstack_cached++] = stack;
+		} else {
+			store_eflags(eflags);
+			memory_free_irqsave(&g_mp, stack);
+			cli();
+		}
+	}
+
+	store_eflags(eflags);
 }
 
 /*
@@ -207,5 +880,39 @@ void task_sleep(TASK *task)
 */
 TASK *task_get_current(void)
 {
-	return multitasking_initialized ? task_manager->tasks[task_manager->now] : NULL;
+	return multitasking_initialized ? task_manager->current : NULL;
+}
+
+/*
+	@brief 遍历已分配的任务。
+	@param prev 上一个任务，NULL 表示从头开始
+	@return 下一个已分配的任务，遍历结束返回 NULL
+*/
+TASK *task_iterate(TASK *prev)
+{
+	if (!multitasking_initialized)
+		return NULL;
+
+	TASK *task = prev ? prev->all_next : task_manager->tasks_head;
+	while (task && task->state == TASK_FREE)
+		task = task->all_next;
+	return task;
+}
+
+/*
+	@brief 获取任务累计运行的 TSC 周期数。
+	@param task 任务
+	@return 周期数，包括当前任务本次运行至今的部分；不支持 TSC 时为 0
+*/
+uint64_t task_get_run_cycles(const TASK *task)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	uint64_t cycles = task->run_cycles;
+	if (multitasking_initialized && task == task_manager->current && switch_tsc)
+		cycles += rdtsc() - switch_tsc;
+
+	store_eflags(eflags);
+	return cycles;
 }
@@ -0,0 +1,150 @@
+/*
+	core/workqueue.c
+*/
+
+#include <ClassiX/debug.h>
+#include <ClassiX/io.h>
+#include <ClassiX/sync.h>
+#include <ClassiX/task.h>
+#include <ClassiX/typedef.h>
+#include <ClassiX/workqueue.h>
+
+WORKQUEUE_STATS g_workqueue_stats;					/* 工作队列统计 */
+
+static WORK *work_head = NULL;						/* 最早提交的工作项 */
+static WORK *work_tail = NULL;						/* 最晚提交的工作项 */
+static WORK *work_running = NULL;					/* 正在执行的工作项 */
+static WAIT_QUEUE worker_wait = WAIT_QUEUE_INITIALIZER;	/* 等待工作项的工作线程 */
+static TASK *worker = NULL;							/* 工作线程 */
+
+/* 工作线程：按提交的先后顺序以开中断执行工作项，队列为空时休眠 */
+static void worker_entry(void *arg)
+{
+	for (;;) {
+		cli();
+		while (!work_head)
+			wait_queue_sleep(&worker_wait, NULL);
+
+		WORK *work = work_head;
+		work_head = work->next;
+		if (!work_head)
+			work_tail = NULL;
+		work->pending = false;
+
+		/* 取出函数与参数后不再访问工作项，函数可以释放工作项所在的对象 */
+		WORK_FUNC func = work->func;
+		void *func_arg = work->arg;
+		work_running = work;
+		sti();
+
+		func(func_arg);
+
+		cli();
+		work_running = NULL;
+		g_workqueue_stats.executed++;
+		sti();
+	}
+}
+
+/*
+	@brief 初始化工作队列，创建工作线程。
+	@note 须在 init_multitasking 之后调用。此前提交的工作项在工作线程创建后执行。
+*/
+void init_workqueue(void)
+{
+	worker = kthread_create(worker_entry, NULL, PRIORITY_HIGH);
+	if (!worker) {
+		debug("WORKQUEUE: Failed to create worker thread.\n");
+		return;
+	}
+	debug("WORKQUEUE: Worker thread %p created.\n", worker);
+}
+
+/*
+	@brief 初始化工作项。
+	@param work 工作项
+	@param func 执行的函数
+	@param arg 传递给函数的参数
+*/
+void work_init(WORK *work, WORK_FUNC func, void *arg)
+{
+	work->func = func;
+	work->arg = arg;
+	work->next = NULL;
+	work->pending = false;
+}
+
+/*
+	@brief 提交工作项，由工作线程在任务上下文中以开中断执行。
+	@param work 工作项
+	@return true - 已加入队列；false - 工作项已在队列中，本次提交与之合并
+	@note 可在中断处理程序中调用。工作线程的优先级为 PRIORITY_HIGH，通常在中断返回前后即开始执行。
+*/
+bool work_queue(WORK *work)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	g_workqueue_stats.queued++;
+	if (work->pending) {
+		g_workqueue_stats.coalesced++;
+		store_eflags(eflags);
+		return false;
+	}
+
+	work->pending = true;
+	work->next = NULL;
+	if (work_tail)
+		work_tail->next = work;
+	else
+		work_head = work;
+	work_tail = work;
+
+	wait_queue_wake_one(&worker_wait);
+
+	store_eflags(eflags);
+	return true;
+}
+
+/*
+	@brief 取消尚未开始执行的工作项。
+	@param work 工作项
+	@return true - 已从队列中移除；false - 工作项不在队列中
+	@note 不等待正在执行的工作项结束，可用 work_busy 查询。
+*/
+bool work_cancel(WORK *work)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+
+	bool removed = false;
+	if (work->pending) {
+		WORK *prev = NULL;
+		for (WORK *current = work_head; current; prev = current, current = current->next) {
+			if (current != work)
+				continue;
+			if (prev)
+				prev->next = work->next;
+			else
+				work_head = work->next;
+			if (work_tail == work)
+				work_tail = prev;
+			work->pending = false;
+			removed = true;
+			break;
+		}
+	}
+
+	store_eflags(eflags);
+	return removed;
+}
+
+/*
+	@brief 查询工作项是否已提交或正在执行。
+	@param work 工作项
+	@return true - 在队列中或正在执行；false - 空闲，可以释放
+*/
+bool work_busy(const WORK *work)
+{
+	return work->pending || work == work_running;
+}
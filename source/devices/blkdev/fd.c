@@ -6,7 +6,7 @@
 #include <ClassiX/cmos.h>
 #include <ClassiX/debug.h>
 #include <ClassiX/io.h>
-#include <ClassiX/pit.h>
+#include <ClassiX/task.h>
 #include <ClassiX/typedef.h>
 
 #define FDC_DOR								0x3f2		/* -W 数字输出寄存器 */
@@ -130,7 +130,7 @@ static void fdc_reset(uint8_t drive)
 	uint8_t dor = 0b00001000; /* 启用 DMA 中断，重置 FDC */
 	dor |= drive_sel[drive & 0x03]; /* 选择驱动器 */
 	out8(FDC_DOR, dor);
-	delay(10); /* 等待 10ms */
+	task_sleep_ms(10); /* 等待 10ms，期间让出处理器 */
 
 	dor &= ~0b00000100; /* 取消重置 FDC */
 	out8(FDC_DOR, dor);
@@ -4,9 +4,9 @@
 
 #include <ClassiX/buzzer.h>
 #include <ClassiX/debug.h>
+#include <ClassiX/fifo.h>
 #include <ClassiX/interrupt.h>
 #include <ClassiX/io.h>
-#include <ClassiX/memory.h>
 #include <ClassiX/pit.h>
 #include <ClassiX/task.h>
 #include <ClassiX/timer.h>
@@ -17,6 +17,8 @@
 #define SPEAKER_DATA_BIT					(1 << 1)	/* 直接驱动扬声器 */
 #define SPEAKER_ENABLE_BITS					(SPEAKER_GATE_BIT | SPEAKER_DATA_BIT)
 
+#define BUZZER_QUEUE_SIZE					(128)		/* 异步请求队列的容量，每个请求占两项 */
+
 /*
 	@brief 设置 PIT 频率。
 	@param divisor PIT 的分频值
@@ -72,7 +74,7 @@ void beep(uint32_t freq, uint32_t duration)
 	set_pit_frequency(divisor);
 	speaker_on();
 
-	delay(duration);
+	task_sleep_ms(duration);
 
 	speaker_off();
 }
@@ -80,6 +82,10 @@ void beep(uint32_t freq, uint32_t duration)
 static TASK *async_buzzer_task = NULL;	/* 异步蜂鸣器任务 */
 static volatile bool is_buzzer_active = false;	/* 蜂鸣器是否正在发声 */
 
+/* 异步请求队列，须在任务创建前初始化 */
+static FIFO buzzer_fifo;
+static uint32_t buzzer_queue_buf[BUZZER_QUEUE_SIZE];
+
 /*
 	@brief 异步蜂鸣器定时器回调函数。
 */
@@ -93,30 +99,31 @@ static void buzzer_timer_callback(void *arg)
 
 /*
 	@brief 异步蜂鸣器任务入口函数。
+	@param arg 异步请求队列
 */
-static void __attribute__((noreturn)) async_buzzer_entry(void)
+static void __attribute__((noreturn)) async_buzzer_entry(void *arg)
 {
-	TASK *task = task_get_current();
+	FIFO *fifo = (FIFO *) arg;
 
 	for (;;) {
 		cli();
-		if (fifo_status(&task->fifo) < 2) {
+		if (fifo_status(fifo) < 2) {
 			sti();
-			task_sleep(task);
+			fifo_wait(fifo, 2);
 		} else {
 			if (is_buzzer_active) {
 				sti();
 				continue; /* 如果蜂鸣器正在发声，忽略新的请求 */
 			}
 
-			uint32_t freq = fifo_pop(&task->fifo);
-			uint32_t duration = fifo_pop(&task->fifo);
+			uint32_t freq = fifo_pop(fifo);
+			uint32_t duration = fifo_pop(fifo);
 			sti();
 
 			if (freq == 0)
 				continue;
 			
-			TIMER *timer = timer_create(buzzer_timer_callback, NULL);
+			TIMER *timer = timer_create(buzzer_timer_callback, NULL, TIMER_FLAG_WORKER | TIMER_FLAG_AUTO_DELETE);
 			if (!timer) {
 				debug("BUZZER: Failed to create timer for async buzzer.\n");
 				continue;
@@ -146,19 +153,14 @@ void async_buzzer_init(void)
 	if (async_buzzer_task)
 		return;
 
-	async_buzzer_task = task_alloc();
-
-	async_buzzer_task->tss.esp = (uint32_t) memory_alloc_irqsave(&g_mp, DEFAULT_USER_STACK, async_buzzer_task) + DEFAULT_USER_STACK;
-	async_buzzer_task->tss.eip = (uint32_t) &async_buzzer_entry;
-	async_buzzer_task->tss.es = 0x10;
-	async_buzzer_task->tss.cs = 0x08;
-	async_buzzer_task->tss.ss = 0x10;
-	async_buzzer_task->tss.ds = 0x10;
-	async_buzzer_task->tss.fs = 0x10;
-	async_buzzer_task->tss.gs = 0x10;
+	/* 任务创建后即可运行，队列须先就绪 */
+	fifo_init(&buzzer_fifo, BUZZER_QUEUE_SIZE, buzzer_queue_buf);
+	async_buzzer_task = kthread_create(async_buzzer_entry, &buzzer_fifo, PRIORITY_NORMAL);
+	if (!async_buzzer_task)
+		return;
 
-	task_register(async_buzzer_task, PRIORITY_NORMAL);
-	fifo_init(&async_buzzer_task->fifo, 128, memory_alloc_irqsave(&g_mp, 128 * sizeof(uint32_t), async_buzzer_task), async_buzzer_task);
+	/* 每 10 ms 保证 500 us，发声的开始不因应用程序负载而推迟 */
+	task_set_realtime(async_buzzer_task, 10, 500);
 }
 
 /*
@@ -174,7 +176,7 @@ void async_beep(uint32_t freq, uint32_t duration)
 	}
 
 	cli();
-	fifo_push(&async_buzzer_task->fifo, freq);
-	fifo_push(&async_buzzer_task->fifo, duration);
+	fifo_push(&buzzer_fifo, freq);
+	fifo_push(&buzzer_fifo, duration);
 	sti();
 }
@@ -139,9 +139,11 @@ int32_t mouse_decoder(MOUSE_DATA *mouse_data, uint8_t data)
 void isr_mouse(ISR_PARAMS *params)
 {
 	uint32_t data = in8(PORT_MOUSE_DATA);
-	fifo_push(mouse_fifo, data + mousedata0);
 
+	/* 先发送 EOI，唤醒的任务可能立即抢占当前任务 */
 	out8(PIC1_OCW2, 0x20); /* 从 PIC EOI */
 	out8(PIC0_OCW2, 0x20); /* 主 PIC EOI */
+
+	fifo_push(mouse_fifo, data + mousedata0);
 	return;
 }
@@ -2,6 +2,7 @@
 	devices/pit.c
 */
 
+#include <ClassiX/cpu.h>
 #include <ClassiX/debug.h>
 #include <ClassiX/interrupt.h>
 #include <ClassiX/io.h>
@@ -11,8 +12,95 @@
 #include <ClassiX/typedef.h>
 
 uint32_t pit_frequency;
+PIT_STATS pit_stats;
+uint32_t tsc_khz;	/* 校准所得的 TSC 频率（kHz），不支持 TSC 时为 0 */
 
 static volatile uint64_t system_ticks = 0; /* 系统时钟滴答计数 */
+static uint16_t pit_divisor;			/* 周期模式的分频值，即每个滴答的计数 */
+
+/* 无滴答模式 */
+static bool oneshot_active = false;		/* 是否处于单次触发模式 */
+static uint16_t oneshot_count;			/* 单次触发模式写入的计数值 */
+static uint32_t oneshot_base;			/* 进入单次触发模式时距上一个滴答已经过的计数 */
+static uint32_t oneshot_carry;			/* 上次退出时不足一个滴答、尚未计入的计数 */
+static bool oneshot_irq_stale = false;	/* 已在中断之外补记，待处理的 PIT 中断不再计入滴答 */
+
+/* 时钟换算：y = (x * mult) >> shift，启动时求出乘数，此后的换算不做除法 */
+typedef struct {
+	uint32_t mult;
+	uint32_t shift;
+} CLOCK_SCALE;
+
+static uint64_t tsc_base;				/* 校准完成时的 TSC，作为纳秒时钟的零点 */
+static CLOCK_SCALE tsc_to_ns;			/* TSC 周期 -> 纳秒 */
+static CLOCK_SCALE us_to_tsc;			/* 微秒 -> TSC 周期 */
+static CLOCK_SCALE tick_to_ns;			/* 滴答 -> 纳秒，不支持 TSC 时使用 */
+static CLOCK_SCALE tick_to_ms;			/* 滴答 -> 毫秒 */
+static CLOCK_SCALE ns_to_tick;			/* 纳秒 -> 滴答 */
+
+/* 求 from -> to 的换算，在乘数不超过 32 位的前提下取最大的移位以保留精度 */
+static CLOCK_SCALE clock_scale(uint64_t from, uint64_t to)
+{
+	uint32_t shift = 32;
+	while (shift > 0 && ((to >> (63 - shift)) || ((to << shift) + from / 2) / from > UINT32_MAX))
+		shift--;
+	return (CLOCK_SCALE) { (uint32_t) (((to << shift) + from / 2) / from), shift };
+}
+
+/* 按换算计算 (value * mult) >> shift，分高低 32 位相乘，避免 96 位中间结果溢出 */
+static inline uint64_t clock_apply(uint64_t value, CLOCK_SCALE scale)
+{
+	uint64_t lo = (uint64_t) (uint32_t) value * scale.mult;
+	uint64_t hi = (value >> 32) * scale.mult;
+	return (lo >> scale.shift) + (hi << (32 - scale.shift));
+}
+
+/*
+	用 PIT 通道 2 计时，测量 TSC 在 PIT_CALIBRATE_MS 毫秒内的增量，返回 TSC 频率（Hz）。
+	通道 2 不可用（OUT 始终不变）时，等待超过 TSC 频率上限下计时长度的 4 倍即放弃，返回 0。
+*/
+static uint64_t pit_calibrate_tsc(void)
+{
+	uint16_t count = PIT_BASE_FREQ * PIT_CALIBRATE_MS / 1000;
+	uint64_t limit = (uint64_t) PIT_CALIBRATE_MAX_KHZ * PIT_CALIBRATE_MS * 4;
+	uint64_t best = UINT64_MAX;
+
+	/* 打开通道 2 的门控，断开扬声器 */
+	uint8_t control = in8(PIT_CH2_CONTROL);
+	out8(PIT_CH2_CONTROL, (control & ~PIT_CH2_SPEAKER) | PIT_CH2_GATE);
+
+	for (int32_t i = 0; i < PIT_CALIBRATE_ROUNDS; i++) {
+		/* 配置 PIT 通道 2：模式 0，计数到 0 时 OUT 变为高电平 */
+		out8(PIT_COMMAND, PIT_CMD_CH2 | PIT_CMD_LOHI | PIT_CMD_MODE0 | PIT_CMD_BINARY);
+		out8(PIT_CHANNEL2, count & 0xff);
+		out8(PIT_CHANNEL2, count >> 8);
+
+		uint64_t start = rdtsc();
+		uint64_t cycles = 0;
+		while (!(in8(PIT_CH2_CONTROL) & PIT_CH2_OUT) && cycles < limit)
+			cycles = rdtsc() - start;
+		if (cycles >= limit) {
+			best = 0;
+			break;
+		}
+		cycles = rdtsc() - start;
+
+		/* 各轮只会因 SMI 等干扰变长，取最短的一轮 */
+		if (cycles < best)
+			best = cycles;
+	}
+
+	out8(PIT_CH2_CONTROL, control);
+	return best * PIT_BASE_FREQ / count;
+}
+
+/* 配置 PIT 通道 0：模式 2（频率发生器），先低字节后高字节 */
+static void pit_set_periodic(void)
+{
+	out8(PIT_COMMAND, PIT_CMD_CH0 | PIT_CMD_LOHI | PIT_CMD_MODE2 | PIT_CMD_BINARY);
+	out8(PIT_CHANNEL0, pit_divisor & 0xff);			/* 低字节 */
+	out8(PIT_CHANNEL0, (pit_divisor >> 8) & 0xff);	/* 高字节 */
+}
 
 /*
 	@brief 初始化可编程间隔定时器（PIT）。
@@ -30,12 +118,28 @@ void init_pit(uint32_t frequency)
 		debug("PIT: PIT frequency too high, setting to max frequency.\n");
 	}
 
-	/* 配置 PIT 通道 0：模式 3（方波），先低字节后高字节 */
-	out8(PIT_COMMAND, PIT_CMD_CH0 | PIT_CMD_LOHI | PIT_CMD_MODE3 | PIT_CMD_BINARY);
+	/* 模式 2 的计数值可直接读出，便于无滴答模式计算滴答内的偏移 */
+	pit_divisor = divisor;
+	pit_set_periodic();
 
-	/* 写入分频值 */
-	out8(PIT_CHANNEL0, divisor & 0xff);			/* 低字节 */
-	out8(PIT_CHANNEL0, (divisor >> 8) & 0xff);	/* 高字节 */
+	tick_to_ns = clock_scale(pit_frequency, 1000000000);
+	tick_to_ms = clock_scale(pit_frequency, 1000);
+	ns_to_tick = clock_scale(1000000000, pit_frequency);
+
+	/* 以 PIT 校准 TSC，此后纳秒时钟与微秒延时均由 TSC 换算 */
+	if (check_tsc_support()) {
+		uint64_t tsc_hz = pit_calibrate_tsc();
+		if (tsc_hz) {
+			tsc_khz = (uint32_t) ((tsc_hz + 500) / 1000);
+			tsc_to_ns = clock_scale(tsc_hz, 1000000000);
+			us_to_tsc = clock_scale(1000000, tsc_hz);
+			tsc_base = rdtsc();
+			debug("PIT: TSC calibrated at %u kHz (mult: %u, shift: %u).\n", tsc_khz, tsc_to_ns.mult, tsc_to_ns.shift);
+		} else {
+			/* tsc_khz 保持为 0，时钟与延时退回按 PIT 滴答计算 */
+			debug("PIT: TSC calibration timed out, falling back to PIT ticks.\n");
+		}
+	}
 
 	/* 注册 IRQ */
 	extern void asm_isr_pit(void);
@@ -43,16 +147,103 @@ void init_pit(uint32_t frequency)
 	debug("PIT: PIT initialized at %d Hz (divisor: %d).\n", frequency, divisor);
 }
 
+/* 退出单次触发模式，按 PIT 实际经过的计数补记滴答，并恢复周期模式 */
+static void tickless_leave(bool from_irq)
+{
+	out8(PIT_COMMAND, PIT_CMD_READBACK | PIT_READBACK_CH0);
+	uint8_t status = in8(PIT_CHANNEL0);
+	uint16_t count = in8(PIT_CHANNEL0);
+	count |= in8(PIT_CHANNEL0) << 8;
+
+	/* OUT 为高电平表示已计数到 0，此后计数器从 0xffff 继续递减 */
+	bool fired = status & PIT_STATUS_OUT;
+	uint32_t elapsed = oneshot_carry + oneshot_base + (fired ? oneshot_count + (uint16_t) -count : oneshot_count - count);
+
+	/* 不足一个滴答的部分留待下次补记；单次触发的计数常非分频值的整数倍，逐次取整会累积偏差 */
+	uint32_t ticks = elapsed / pit_divisor;
+	oneshot_carry = elapsed % pit_divisor;
+	system_ticks += ticks;
+	pit_stats.ticks_skipped += ticks;
+
+	pit_set_periodic();
+	oneshot_active = false;
+	oneshot_irq_stale = fired && !from_irq;
+}
+
+/*
+	@brief 进入无滴答模式：停止周期中断，改为在指定时刻触发一次中断。
+	@param deadline 最迟须唤醒的系统滴答数
+	@note 须在关中断时由空闲任务调用。距离 deadline 不足两个滴答时保持周期模式；
+		  超出单次触发的最大计数时提前唤醒，由空闲任务再次进入。
+*/
+void pit_tickless_enter(uint64_t deadline)
+{
+	if (oneshot_active || deadline <= system_ticks + 1)
+		return;
+
+	uint64_t max_ticks = PIT_ONESHOT_MAX / pit_divisor + 1;
+	uint64_t ticks = deadline - system_ticks;
+	if (ticks > max_ticks)
+		ticks = max_ticks;
+
+	/* 模式 2 的计数值从分频值递减至 1 */
+	out8(PIT_COMMAND, PIT_CMD_CH0 | PIT_CMD_LATCH);
+	uint16_t count = in8(PIT_CHANNEL0);
+	count |= in8(PIT_CHANNEL0) << 8;
+	oneshot_base = pit_divisor - count;
+
+	uint64_t counts = ticks * pit_divisor - oneshot_base - oneshot_carry;
+	oneshot_count = counts > PIT_ONESHOT_MAX ? PIT_ONESHOT_MAX : (uint16_t) counts;
+
+	/* 配置 PIT 通道 0：模式 0（计数结束时中断） */
+	out8(PIT_COMMAND, PIT_CMD_CH0 | PIT_CMD_LOHI | PIT_CMD_MODE0 | PIT_CMD_BINARY);
+	out8(PIT_CHANNEL0, oneshot_count & 0xff);
+	out8(PIT_CHANNEL0, oneshot_count >> 8);
+
+	oneshot_active = true;
+	pit_stats.tickless_entries++;
+}
+
+/*
+	@brief 退出无滴答模式，补记休眠期间的滴答。
+	@note 须在关中断时调用；未处于无滴答模式时立即返回。
+*/
+void pit_tickless_exit(void)
+{
+	if (oneshot_active)
+		tickless_leave(false);
+}
+
 void isr_pit(ISR_PARAMS *params)
 {
-	/* 增加系统时钟滴答计数 */
-	system_ticks++;
+	uint64_t entry = tsc_khz ? rdtsc() : 0;
+	pit_stats.interrupts++;
 
-	/* 定时器过程 */
-	timer_process();
+	/* 增加系统时钟滴答计数 */
+	if (oneshot_active)
+		tickless_leave(true);	/* 单次触发到期，补记休眠期间的滴答 */
+	else if (oneshot_irq_stale)
+		oneshot_irq_stale = false;	/* 该中断已在退出无滴答模式时计入 */
+	else
+		system_ticks++;
 
-	/* 发送 EOI 到 PIC */
+	/* 先发送 EOI，定时器回调的耗时不再推迟后续的中断 */
 	out8(PIC0_OCW2, 0x20); /* 主 PIC EOI */
+	if (tsc_khz) {
+		uint32_t cycles = (uint32_t) (rdtsc() - entry);
+		if (cycles > pit_stats.eoi_cycles_max)
+			pit_stats.eoi_cycles_max = cycles;
+	}
+
+	/* 定时器过程：回调唤醒的任务推迟到处理完毕后再运行，期间不会切换任务而重入 */
+	task_preempt_disable();
+	timer_process();
+	if (tsc_khz) {
+		uint32_t cycles = (uint32_t) (rdtsc() - entry);
+		if (cycles > pit_stats.irq_off_cycles_max)
+			pit_stats.irq_off_cycles_max = cycles;
+	}
+	task_preempt_enable();
 
 	/* 任务调度 */
 	extern uint64_t next_schedule_tick;
@@ -75,7 +266,30 @@ uint64_t get_system_ticks(void)
 */
 uint64_t get_system_milliseconds(void)
 {
-	return system_ticks * 1000 / pit_frequency;
+	return clock_apply(system_ticks, tick_to_ms);
+}
+
+/*
+	@brief 获取系统运行时间（纳秒）。
+	@return 自 PIT 初始化以来经过的纳秒数
+	@note 支持 TSC 时由 TSC 换算，分辨率为 TSC 周期量级；否则退化为滴答的分辨率。
+*/
+uint64_t get_system_nanoseconds(void)
+{
+	if (tsc_khz)
+		return clock_apply(rdtsc() - tsc_base, tsc_to_ns);
+	return clock_apply(system_ticks, tick_to_ns);
+}
+
+/*
+	@brief 将纳秒数换算为滴答数。
+	@param ns 纳秒数
+	@return 向下取整的滴答数
+	@note 只做乘法与移位，可在任务切换等频繁调用的路径中使用。
+*/
+uint64_t ns_to_ticks(uint64_t ns)
+{
+	return clock_apply(ns, ns_to_tick);
 }
 
 /*
@@ -89,9 +303,27 @@ void reset_system_ticks(void)
 /*
 	@brief 阻塞延时。
 	@param ms 延时时长（毫秒）
+	@note 忙等待期间不让出处理器，且依赖 PIT 中断；任务中应使用 task_sleep_ms。
 */
 void delay(uint32_t ms)
 {
 	uint64_t end_tick = ms * pit_frequency / 1000 + system_ticks;
 	while (system_ticks < end_tick) { }
 }
+
+/*
+	@brief 微秒级忙等待延时。
+	@param us 延时时长（微秒）
+	@note 不依赖 PIT 中断，可在关中断时调用。不支持 TSC 时以端口 0x80 的读写计时，每次约 1 微秒。
+*/
+void udelay(uint32_t us)
+{
+	if (tsc_khz) {
+		uint64_t end = rdtsc() + clock_apply(us, us_to_tsc);
+		while (rdtsc() < end)
+			pause();
+	} else {
+		while (us--)
+			out8(0x80, 0);
+	}
+}
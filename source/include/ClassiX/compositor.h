@@ -0,0 +1,54 @@
+/*
+	include/ClassiX/compositor.h
+*/
+
+#ifndef _CLASSIX_COMPOSITOR_H_
+#define _CLASSIX_COMPOSITOR_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <ClassiX/layer.h>
+#include <ClassiX/typedef.h>
+#include <ClassiX/window.h>
+
+#define COMPOSITOR_QUEUE_SIZE				(64)		/* 合成请求队列的容量，须为 2 的幂 */
+#define COMPOSITOR_MAX_MOVES				(16)		/* 一帧内可合并的不同图层数 */
+
+/* 合成请求 */
+typedef enum {
+	COMPOSE_MOVE = 0,			/* 移动图层 */
+	COMPOSE_ACTIVATE			/* 激活窗口 */
+} COMPOSE_OP;
+
+typedef struct {
+	COMPOSE_OP op;
+	LAYER *layer;				/* 目标图层，NULL 表示请求已撤销 */
+	WINDOW *window;				/* COMPOSE_ACTIVATE 的目标窗口 */
+	int32_t x, y;				/* COMPOSE_MOVE 的目标位置 */
+	uint64_t tsc;				/* 请求发出的 TSC 时刻，不支持 TSC 时为 0 */
+} COMPOSE_REQUEST;
+
+/* 合成统计 */
+typedef struct {
+	uint32_t requests;			/* 处理的请求数 */
+	uint32_t frames;			/* 合成的帧数 */
+	uint32_t coalesced;			/* 被同一帧内后续移动取代的移动请求数 */
+	uint32_t stalls;			/* 队列已满、输入任务等待的次数 */
+	uint64_t latency_total;		/* 每帧最早的请求至该帧完成的 TSC 周期数之和 */
+	uint32_t latency_max;		/* 上述周期数的最大值 */
+} COMPOSITOR_STATS;
+
+extern COMPOSITOR_STATS g_compositor_stats;
+
+bool init_compositor(void);
+void compositor_move(LAYER *layer, int32_t x, int32_t y);
+void compositor_activate(WINDOW *window);
+void compositor_cancel(LAYER *layer);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
@@ -9,22 +9,22 @@
 	extern "C" {
 #endif
 
+#include <ClassiX/sync.h>
 #include <ClassiX/typedef.h>
 #include <ClassiX/window.h>
 
-typedef struct TASK TASK;
-
 typedef struct {
 	uint32_t *buf;
 	int32_t idx_read, idx_write;
 	size_t size, free;
-	TASK *task;
+	WAIT_QUEUE waiters;	/* 等待数据的任务 */
 } FIFO;
 
-void fifo_init(FIFO *fifo, size_t size, uint32_t *buf, TASK *task);
+void fifo_init(FIFO *fifo, size_t size, uint32_t *buf);
 int32_t fifo_push(FIFO *fifo, uint32_t data);
 uint32_t fifo_pop(FIFO *fifo);
 int32_t fifo_status(const FIFO *fifo);
+void fifo_wait(FIFO *fifo, int32_t count);
 int32_t fifo_push_event(FIFO *fifo, const EVENT *event);
 int32_t fifo_pop_event(FIFO *fifo, EVENT *event);
 
@@ -25,12 +25,15 @@ static_assert(sizeof(HANDLE) == sizeof(uint32_t), "`HANDLE` must be 32 bits");
 
 #define HANDLE_NULL							((HANDLE) { .value = 0 }) /* 空句柄 */
 
+#define HANDLE_FLAGS_MASK					(0b00000011)	/* 句柄标志的有效位 */
+#define HANDLE_ENTRY_USED					(0x80000000)	/* 槽位已占用 */
+
 typedef struct {
 	union {
 		void *object;				/* 占用时的对象指针 */
 		int32_t next_free;			/* 空闲时的下一个空闲句柄索引，-1 表示末尾 */
 	};
-	uint32_t flags;					/* 占用时的标志 */
+	uint32_t flags;					/* 占用时的标志，含 `HANDLE_ENTRY_USED` */
 	uint32_t generation;			/* 占用时的代数 */
 	void (*destructor)(void *);		/* 对象析构函数 */
 } HANDLE_ENTRY;
@@ -16,8 +16,9 @@
 #define AR_3_CODE32_ER						(0x04fa)		/* 可执行、可读、访问级别 3 */
 #define AR_3_DATA32_RW						(0x04f2)		/* 可读写、访问级别 3 */
 
-#define GDT_LIMIT							(8192)
-#define TASK_GDT0							(3)
+#define GDT_LIMIT							(5)
+#define TASK_LDT_GDT						(3)				/* 运行应用程序的任务共用的 LDT 描述符 */
+#define TASK_TSS_GDT						(4)				/* TSS 描述符 */
 
 #define IDT_LIMIT							(256)
 
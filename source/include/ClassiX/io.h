@@ -12,6 +12,7 @@
 #include <ClassiX/typedef.h>
 
 #define hlt()								asm volatile ("hlt")
+#define sti_hlt()							asm volatile ("sti\n\thlt")	/* sti 的下一条指令执行前不响应中断，避免错过唤醒 */
 #define cli()								asm volatile ("cli")
 #define sti()								asm volatile ("sti")
 #define nop()								asm volatile ("nop")
@@ -34,6 +35,8 @@
 	asm volatile ("inl %%dx, %%eax":"=a"(_data):"d"(port));	\
 	_data; })
 
+#define EFLAGS_IF							(1 << 9)	/* 中断允许标志 */
+
 #define store_eflags(eflags) 				asm volatile ("push %0\npopfl"::"r"((uint32_t) (eflags)):"cc", "memory")
 
 #define load_eflags() ({									\
@@ -108,6 +111,7 @@ typedef union {
 	_cr4; })
 
 #define load_tr(sel)						asm volatile ("ltr %0"::"r"(sel))
+#define load_ldtr(sel)						asm volatile ("lldt %w0"::"r"(sel))
 
 #ifdef __cplusplus
 	}
@@ -13,31 +13,96 @@
 #include <ClassiX/task.h>
 #include <ClassiX/typedef.h>
 
-#define ALLOC_ALIGNMENT					(128)
+/* #define MEMORY_TRACE */		/* 经串口输出 kmalloc 系列函数的分配轨迹，可由 bench/ 在主机上回放 */
+
+#define ALLOC_ALIGNMENT					(16)	/* 内存块大小的粒度，亦为 kmalloc 返回指针的默认对齐 */
 #define ALIGN_UP(x, align)				(((x) + (align) - 1) & ~((align) - 1))
 
+#define MEMORY_SL_LOG2					(4)
+#define MEMORY_SL_COUNT					(1 << MEMORY_SL_LOG2)	/* 每个一级类别中的二级类别数 */
+#define MEMORY_FL_COUNT					(25)	/* 一级类别数，覆盖 2^31 字节以下的块 */
+
+#define MEMORY_HIST_BUCKETS				(16)	/* 空闲块大小直方图的桶数 */
+#define MEMORY_HIST_MIN_SHIFT			(6)		/* 第 0 桶的上界为 2^(MIN_SHIFT + 1) 字节 */
+
+/* 内存块链表节点 */
+typedef struct MEMORY_LINK {
+	struct MEMORY_LINK *prev;
+	struct MEMORY_LINK *next;
+} MEMORY_LINK;
+
+/* 分配域：记录任务在一段时间内分配的内存块，以便一次性回收 */
+typedef struct MEMORY_ARENA {
+	MEMORY_LINK blocks;				/* 内存块环形链表的哨兵 */
+	size_t bytes;					/* 占用字节数（包括头尾） */
+	uint32_t count;					/* 内存块数量 */
+	struct MEMORY_ARENA *parent;	/* 外层分配域 */
+} MEMORY_ARENA;
+
+/* 内存池统计，随分配与释放更新 */
+typedef struct {
+	uint32_t alloc_count;		/* 累计分配次数 */
+	uint32_t free_count;		/* 累计释放次数 */
+	uint32_t fail_count;		/* 分配失败次数 */
+	size_t bytes_in_use;		/* 已分配字节数（包括头尾） */
+	size_t peak_bytes;			/* 已分配字节数的峰值 */
+	uint32_t realloc_inplace;	/* krealloc 原地完成的次数 */
+	uint32_t realloc_moved;		/* krealloc 搬移数据的次数 */
+	uint32_t deferred_frees;	/* 经延迟释放环归还的次数 */
+	uint32_t defer_overflows;	/* 延迟释放环已满、只能就地释放的次数 */
+	uint64_t irqoff_max;		/* 持有内存池锁（关中断）的最长时间，单位为 TSC 周期 */
+	uint64_t irq_free_max;		/* 关中断时调用 kfree 的最长耗时，单位为 TSC 周期 */
+	uint32_t zero_hits;			/* kcalloc 取得预清零内存块的次数 */
+	uint32_t zero_misses;		/* kcalloc 未取得预清零内存块的次数 */
+	size_t zeroed_bytes;		/* 预清零内存块占用的字节数（包括头尾） */
+} MEMORY_STATS;
+
+/* 内存池快照 */
+typedef struct {
+	MEMORY_STATS stats;			/* 统计 */
+	size_t total_size;			/* 内存池大小 */
+	size_t free_bytes;			/* 空闲字节数（包括头尾） */
+	uint32_t free_blocks;		/* 空闲块数量 */
+	size_t largest_free;		/* 最大空闲块大小（包括头尾） */
+	uint32_t histogram[MEMORY_HIST_BUCKETS];	/* 空闲块大小直方图，第 i 桶为 [2^(i+6), 2^(i+7)) 字节 */
+} MEMORY_INFO;
+
 typedef struct {
 	void *start;
 	size_t size;
-	void *head;			/* 空闲块列表头 */
+	uint32_t fl_bitmap;								/* 非空一级类别位图 */
+	uint32_t sl_bitmap[MEMORY_FL_COUNT];			/* 各一级类别中非空二级类别位图 */
+	void *free_lists[MEMORY_FL_COUNT][MEMORY_SL_COUNT];	/* 各类别的空闲块链表头 */
 	spinlock_t lock;	/* 内存池锁 */
+	uint64_t lock_tsc;	/* 最近一次获取锁的时刻 */
+	MEMORY_STATS stats;	/* 统计 */
 } MEMORY_POOL;
 
 extern MEMORY_POOL g_mp;
 
 void memory_init(MEMORY_POOL *pool, void *base, size_t size);
 void *memory_alloc(MEMORY_POOL *pool, size_t size, TASK *task);
+void *memory_alloc_aligned(MEMORY_POOL *pool, size_t size, size_t align, TASK *task);
 void memory_free(MEMORY_POOL *pool, void *ptr);
 
 void *memory_alloc_irqsave(MEMORY_POOL *pool, size_t size, TASK *task);
 void memory_free_irqsave(MEMORY_POOL *pool, void *ptr);
 
+void memory_arena_enter(TASK *task, MEMORY_ARENA *arena);
+void memory_arena_leave(TASK *task, MEMORY_ARENA *arena);
+size_t memory_arena_release(MEMORY_POOL *pool, TASK *task, MEMORY_ARENA *arena);
+
 void *kmalloc(size_t size);
+void *kmalloc_aligned(size_t size, size_t align);
 void *krealloc(void *ptr, size_t new_size);
 void *kcalloc(size_t nmemb, size_t size);
 void kfree(void *ptr);
+void kfree_drain(void);
+bool kzero_refill(void);
 
 size_t get_free_memory(const MEMORY_POOL *pool);
+void memory_get_info(MEMORY_POOL *pool, MEMORY_INFO *info);
+void memory_dump_info(MEMORY_POOL *pool);
 
 #ifdef __cplusplus
 	}
@@ -0,0 +1,38 @@
+/*
+	include/ClassiX/page.h
+*/
+
+#ifndef _CLASSIX_PAGE_H_
+#define _CLASSIX_PAGE_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <ClassiX/multiboot.h>
+#include <ClassiX/typedef.h>
+
+#define PAGE_SIZE							(4096)		/* 页大小 */
+#define PAGE_SHIFT							(12)		/* 页大小的位数 */
+#define PAGE_MAX_ORDER						(14)		/* 最大阶，单次最多分配 2^14 页（64 MiB） */
+
+#define KMALLOC_PAGE_MIN_SIZE				(64 * 1024)	/* 由页分配器服务的最小 kmalloc 请求 */
+
+void page_init(const multiboot_info_t *mbi, uintptr_t reserved_end);
+
+void *page_alloc(uint32_t order);
+void *page_alloc_size(size_t size);
+void page_free(void *addr);
+
+bool page_owns(const void *addr);
+size_t page_block_size(const void *addr);
+uint32_t page_order(size_t size);
+
+size_t page_get_free_count(void);
+size_t page_get_total_count(void);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
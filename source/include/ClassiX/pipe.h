@@ -10,18 +10,17 @@
 #endif
 
 #include <ClassiX/spinlock.h>
+#include <ClassiX/sync.h>
 #include <ClassiX/typedef.h>
 
-typedef struct TASK TASK;
-
 typedef struct {
 	uint8_t *buf;		/* 缓冲区 */
 	size_t size;		/* 总容量 */
 	size_t free;		/* 可用容量 */
 	size_t pos_read;	/* 读索引 */
 	size_t pos_write;	/* 写索引 */
-	TASK *reader;		/* 等待的读任务 */
-	TASK *writer;		/* 等待的写任务 */
+	WAIT_QUEUE readers;	/* 等待数据的读任务 */
+	WAIT_QUEUE writers;	/* 等待空间的写任务 */
 	spinlock_t lock;	/* 自旋锁 */
 } PIPE;
 
@@ -34,16 +34,45 @@
 #define PIT_CMD_MODE5						(0x0a)		/* 硬件触发选通 */
 #define PIT_CMD_BINARY						(0x00)		/* 二进制计数 */
 #define PIT_CMD_BCD							(0x01)		/* BCD 计数 */
+#define PIT_CMD_READBACK					(0xc0)		/* 读回命令，同时锁存计数值与状态 */
+#define PIT_READBACK_CH0					(0x02)		/* 读回通道 0 */
+#define PIT_STATUS_OUT						(0x80)		/* 读回状态中 OUT 引脚的电平 */
+
+/* 通道 2 门控端口 */
+#define PIT_CH2_CONTROL						(0x61)		/* 通道 2 门控与扬声器控制端口 */
+#define PIT_CH2_GATE						(1 << 0)	/* 允许通道 2 计数 */
+#define PIT_CH2_SPEAKER						(1 << 1)	/* 将通道 2 输出接到扬声器 */
+#define PIT_CH2_OUT							(1 << 5)	/* 通道 2 OUT 引脚的电平 */
 
 #define PIT_BASE_FREQ						(1193182)	/* PIT 的基准频率 (1.193182 MHz) */
+#define PIT_ONESHOT_MAX						(0xffff)	/* 单次触发模式的最大计数值，约 54.9 ms */
+#define PIT_CALIBRATE_MS					(20)		/* 校准 TSC 时每轮的 PIT 计时长度 */
+#define PIT_CALIBRATE_ROUNDS				(3)			/* 校准 TSC 的轮数，取最短的一轮 */
+#define PIT_CALIBRATE_MAX_KHZ				(10000000)	/* 校准超时按此 TSC 频率上限估算，约 10 GHz */
+
+/* PIT 统计 */
+typedef struct {
+	uint64_t interrupts;		/* PIT 中断次数 */
+	uint32_t tickless_entries;	/* 进入单次触发（无滴答）模式的次数 */
+	uint64_t ticks_skipped;		/* 退出无滴答模式时补记的滴答数 */
+	uint32_t eoi_cycles_max;	/* 自进入中断处理程序至发送 EOI 的最长 TSC 周期数，不支持 TSC 时为 0 */
+	uint32_t irq_off_cycles_max;	/* 中断处理程序关中断执行（含定时器回调）的最长 TSC 周期数 */
+} PIT_STATS;
 
 extern uint32_t pit_frequency;
+extern PIT_STATS pit_stats;
+extern uint32_t tsc_khz;
 
 void init_pit(uint32_t frequency);
 uint64_t get_system_ticks(void);
 uint64_t get_system_milliseconds(void);
+uint64_t get_system_nanoseconds(void);
+uint64_t ns_to_ticks(uint64_t ns);
 void reset_system_ticks(void);
 void delay(uint32_t ms);
+void udelay(uint32_t us);
+void pit_tickless_enter(uint64_t deadline);
+void pit_tickless_exit(void);
 
 #ifdef __cplusplus
 	}
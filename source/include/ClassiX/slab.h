@@ -0,0 +1,49 @@
+/*
+	include/ClassiX/slab.h
+*/
+
+#ifndef _CLASSIX_SLAB_H_
+#define _CLASSIX_SLAB_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <ClassiX/spinlock.h>
+#include <ClassiX/typedef.h>
+
+#define SLAB_SIZE							(4096)		/* 每个 slab 的大小，同时也是其对齐要求 */
+#define KMALLOC_MIN_SIZE					(16)		/* 最小尺寸类别 */
+#define KMALLOC_MAX_SIZE					(512)		/* 由尺寸类别缓存服务的最大请求 */
+
+typedef struct KMEM_CACHE {
+	const char *name;			/* 缓存名称 */
+	size_t size;				/* 对象大小（已对齐） */
+	size_t offset;				/* 首个对象在 slab 中的偏移 */
+	uint32_t objs_per_slab;		/* 每个 slab 容纳的对象数 */
+	void *partial;				/* 部分使用的 slab 链表 */
+	void *full;					/* 已满的 slab 链表 */
+	void *empty;				/* 保留的空 slab，避免频繁归还 */
+	uint32_t slabs;				/* slab 数量 */
+	uint32_t active;			/* 已分配的对象数 */
+	spinlock_t lock;			/* 缓存锁 */
+	struct KMEM_CACHE *next;	/* 缓存链表 */
+} KMEM_CACHE;
+
+void kmem_init(void);
+
+KMEM_CACHE *kmem_cache_create(const char *name, size_t size, size_t align);
+void kmem_cache_destroy(KMEM_CACHE *cache);
+void *kmem_cache_alloc(KMEM_CACHE *cache);
+void kmem_cache_free(KMEM_CACHE *cache, void *obj);
+
+void *kmem_alloc(size_t size);
+void kmem_free(void *obj);
+bool kmem_owns(const void *ptr);
+size_t kmem_object_size(const void *obj);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
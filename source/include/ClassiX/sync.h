@@ -0,0 +1,58 @@
+/*
+	include/ClassiX/sync.h
+*/
+
+#ifndef _CLASSIX_SYNC_H_
+#define _CLASSIX_SYNC_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <ClassiX/spinlock.h>
+#include <ClassiX/typedef.h>
+
+typedef struct TASK TASK;
+
+/* 等待队列：按进入的先后顺序唤醒休眠的任务 */
+typedef struct WAIT_QUEUE {
+	TASK *head;		/* 最早进入的任务 */
+	TASK *tail;		/* 最晚进入的任务 */
+} WAIT_QUEUE;
+
+#define WAIT_QUEUE_INITIALIZER				{ NULL, NULL }
+
+/* 休眠互斥锁：获取失败的任务休眠，释放时按先后顺序直接移交所有权 */
+typedef struct {
+	TASK *owner;		/* 持有者，NULL 表示未锁定 */
+	WAIT_QUEUE waiters;	/* 等待获取的任务 */
+} MUTEX;
+
+#define MUTEX_INITIALIZER					{ NULL, WAIT_QUEUE_INITIALIZER }
+
+/* 计数信号量 */
+typedef struct {
+	uint32_t count;		/* 可用资源数 */
+	WAIT_QUEUE waiters;	/* 等待资源的任务 */
+} SEMAPHORE;
+
+void wait_queue_init(WAIT_QUEUE *wq);
+bool wait_queue_sleep(WAIT_QUEUE *wq, spinlock_t *lock);
+TASK *wait_queue_wake_one(WAIT_QUEUE *wq);
+uint32_t wait_queue_wake_all(WAIT_QUEUE *wq);
+
+void mutex_init(MUTEX *mutex);
+void mutex_lock(MUTEX *mutex);
+bool mutex_trylock(MUTEX *mutex);
+void mutex_unlock(MUTEX *mutex);
+
+void semaphore_init(SEMAPHORE *sem, uint32_t count);
+void semaphore_down(SEMAPHORE *sem);
+bool semaphore_trydown(SEMAPHORE *sem);
+void semaphore_up(SEMAPHORE *sem);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
@@ -14,10 +14,13 @@
 #include <ClassiX/interrupt.h>
 #include <ClassiX/typedef.h>
 
-#define MAX_TASKS							(1000)
-
 #define DEFAULT_USER_STACK					(64 * 1024)
+#define KTHREAD_STACK_SIZE					(64 * 1024)	/* 内核线程的栈大小 */
+#define KTHREAD_STACK_CACHE					(8)			/* 缓存的已回收内核线程栈数 */
 #define TIME_SLICE_BASE_PER_PRIORITY_MS		(1)
+#define TASK_RT_UTIL_MAX					(900)		/* 全部实时任务可预留的处理器份额上限（千分比），其余留给普通任务 */
+#define TASK_RT_PERIOD_MAX_MS				(1000)		/* 实时预留周期的上限（毫秒） */
+#define TASK_LATENCY_BUCKETS				(12)		/* 唤醒延迟直方图的桶数，第 i 桶为 [2^(i-1), 2^i) 微秒，末桶不设上限 */
 
 typedef enum {
 	TASK_FREE = 0,
@@ -32,6 +35,8 @@ typedef enum {
 	PRIORITY_HIGH,
 } TASK_PRIORITY;
 
+#define TASK_PRIORITY_LEVELS				(PRIORITY_HIGH + 1)
+
 typedef struct {
 	uint32_t backlink, esp0, ss0, esp1, ss1, esp2, ss2, cr3;
 	uint32_t eip, eflags, eax, ecx, edx, ebx, esp, ebp, esi, edi;
@@ -48,13 +53,40 @@ typedef struct {
 	uint8_t base_high;
 } SEGMENT_DESCRIPTOR;
 
+typedef void (*KTHREAD_ENTRY)(void *arg);
+
 typedef struct TASK {
 	/* 任务控制块 */
-	int32_t selector;			/* GDT 选择子 */
+	int32_t id;					/* 任务编号，任务对象复用时保持不变 */
 	TASK_STATE state;			/* 任务状态 */
 	TASK_PRIORITY priority;		/* 任务优先级 */
 	FIFO fifo;					/* 任务专用 FIFO */
-	TSS tss;					/* 任务状态段 */
+	TSS tss;					/* 初始寄存器、LDT 选择子及用户态程序的内核栈 */
+	uint32_t context_esp;		/* 切换出去时保存的栈指针，0 表示尚未运行 */
+	struct TASK *rq_prev;		/* 同优先级运行队列中的前一个任务 */
+	struct TASK *rq_next;		/* 同优先级运行队列中的后一个任务 */
+	struct TIMER *sleep_timer;	/* 定时休眠的唤醒定时器，未在定时休眠时为 NULL */
+	struct WAIT_QUEUE *wait_queue;	/* 所在的等待队列，NULL 表示未在等待 */
+	struct TASK *wait_prev;		/* 等待队列中的前一个任务 */
+	struct TASK *wait_next;		/* 等待队列中的后一个任务 */
+	struct TASK *all_next;		/* 全部任务对象链表中的后一个 */
+
+	/* 调度统计，任务对象复用时清零；不支持 TSC 时周期数均为 0 */
+	uint64_t run_cycles;		/* 累计运行的 TSC 周期数（含运行期间的中断处理） */
+	uint64_t wake_tsc;			/* 被唤醒的 TSC 时刻，0 表示未在等待运行 */
+	uint32_t wake_latency_max;	/* 自唤醒至开始运行的最长 TSC 周期数 */
+	uint32_t voluntary_switches;	/* 因休眠而让出处理器的次数 */
+	uint32_t involuntary_switches;	/* 仍就绪时被抢占或时间片用完的次数 */
+
+	/* 实时调度（EDF），rt_period 为 0 表示普通任务 */
+	uint32_t rt_period;			/* 预留周期（系统滴答数） */
+	uint32_t rt_budget;			/* 每个周期的预算（纳秒） */
+	uint32_t rt_runtime;		/* 本周期剩余的预算（纳秒） */
+	uint32_t rt_util;			/* 预留的处理器份额（千分比） */
+	uint64_t rt_deadline;		/* 本周期的截止时刻（系统滴答数） */
+	bool rt_throttled;			/* 本周期预算已用尽，暂按普通优先级运行 */
+	bool rt_queued;				/* 位于实时运行队列中 */
+	struct TIMER *rt_timer;		/* 就绪且预算用尽时在截止时刻补足预算的单次定时器 */
 
 	/* 应用程序用参数 */
 	SEGMENT_DESCRIPTOR ldt[2];	/* 段描述符 */
@@ -67,20 +99,53 @@ typedef struct TASK {
 	char **argv;				/* 参数数组 */
 	HANDLE_TABLE hfile_table;	/* 文件句柄表 */
 	HANDLE_TABLE hwnd_table;	/* 串口句柄表 */
+	struct MEMORY_ARENA *arena;	/* 当前分配域，NULL 表示不跟踪 */
+	size_t mem_bytes;			/* 占用的内核内存池字节数 */
+	void *kstack;				/* 内核线程的栈（由 kthread_create 分配），NULL 表示不是内核线程 */
 
 	/* FPU 数据 */
 	bool fpu_used; /* 是否使用过 FPU */
 	uint8_t fpu_state[512] __attribute__((aligned(16))); /* FPU 数据 */
 } TASK;
 
-#define TID(task)							(((task)->selector) / 8)
+/* 任务切换统计 */
+typedef struct {
+	uint32_t switches;			/* 任务切换次数 */
+	uint32_t fpu_traps;			/* #NM 异常次数 */
+	uint32_t fpu_swaps;			/* 实际保存或恢复 FPU 状态的次数 */
+	uint32_t timed_sleeps;		/* 定时休眠的次数 */
+	uint64_t slept_ticks;		/* 定时休眠期间让给其他任务的滴答数 */
+	uint32_t kthreads_created;	/* 创建的内核线程数 */
+	uint32_t kthreads_reaped;	/* 已退出并回收的内核线程数 */
+	uint32_t kstacks_reused;	/* 复用缓存栈创建内核线程的次数 */
+	uint32_t task_objects;		/* 已创建的任务对象数（含空闲待复用的） */
+	uint32_t rt_throttles;		/* 实时任务预算用尽的次数 */
+	uint32_t wake_latency[TASK_LATENCY_BUCKETS];	/* 自唤醒至开始运行的延迟直方图 */
+} TASK_STATS;
+
+extern TSS g_tss;
+extern TASK *g_fpu_owner;
+extern TASK_STATS g_task_stats;
+
+#define TID(task)							((task)->id)
 
 TASK *init_multitasking(void);
 TASK *task_alloc(void);
+void task_load_ldt(TASK *task);
 void task_register(TASK *task, TASK_PRIORITY priority);
+int32_t task_set_realtime(TASK *task, uint32_t period_ms, uint32_t budget_us);
+void task_preempt_disable(void);
+void task_preempt_enable(void);
 void task_schedule(void);
 void task_sleep(TASK *task);
+void task_sleep_until(uint64_t tick);
+void task_sleep_ms(uint32_t ms);
+TASK *kthread_create(KTHREAD_ENTRY entry, void *arg, TASK_PRIORITY priority);
+void kthread_exit(void) __attribute__((noreturn));
+void kthread_reap(void);
 TASK *task_get_current(void);
+TASK *task_iterate(TASK *prev);
+uint64_t task_get_run_cycles(const TASK *task);
 
 #ifdef __cplusplus
 	}
@@ -10,11 +10,20 @@
 #endif
 
 #include <ClassiX/typedef.h>
+#include <ClassiX/workqueue.h>
+
+#define TIMER_WHEEL_BITS					(6)
+#define TIMER_WHEEL_SIZE					(1 << TIMER_WHEEL_BITS)	/* 时间轮每级的槽数 */
+#define TIMER_WHEEL_LEVELS					(4)		/* 时间轮级数，共覆盖 2^24 个滴答 */
+
+/* 定时器标志 */
+#define TIMER_FLAG_WORKER					(1 << 0)	/* 回调提交到工作队列，在工作线程中以开中断执行 */
+#define TIMER_FLAG_AUTO_DELETE				(1 << 1)	/* 最后一次到期后由 timer_cleanup 回收，创建者不再持有 */
 
 typedef enum {
 	TIMER_INACTIVE = 0,			/* 定时器未激活 */
 	TIMER_ACTIVE,				/* 定时器已激活 */
-	TIMER_EXPIRED				/* 定时器已过期 */
+	TIMER_EXPIRED				/* 定时器已过期，且未再启动 */
 } TIMER_STATE;
 
 /* 定时器回调函数类型 */
@@ -27,15 +36,20 @@ typedef struct TIMER {
 	TIMER_CALLBACK callback;	/* 回调函数 */
 	void *arg;					/* 传递给回调函数的参数 */
 	TIMER_STATE state;			/* 定时器状态 */
-	struct TIMER *next;			/* 指向下一个定时器的指针 */
+	uint32_t flags;				/* 定时器标志 */
+	WORK work;					/* 带 TIMER_FLAG_WORKER 时执行回调的工作项 */
+	struct TIMER *prev;			/* 同一链表中的前一个定时器 */
+	struct TIMER *next;			/* 同一链表中的后一个定时器 */
+	struct TIMER **list;		/* 所在链表（时间轮的槽或未激活链表）的表头 */
 } TIMER;
 
-TIMER *timer_create(TIMER_CALLBACK callback, void *arg);
+TIMER *timer_create(TIMER_CALLBACK callback, void *arg, uint32_t flags);
 int32_t timer_start(TIMER *timer, uint64_t interval, int32_t repetition);
 int32_t timer_stop(TIMER *timer);
 int32_t timer_delete(TIMER *timer);
 void timer_process(void);
 void timer_cleanup(void);
+uint64_t timer_next_expiry(void);
 uint32_t timer_get_count(void);
 uint32_t timer_get_active_count(void);
 
@@ -0,0 +1,46 @@
+/*
+	include/ClassiX/workqueue.h
+*/
+
+#ifndef _CLASSIX_WORKQUEUE_H_
+#define _CLASSIX_WORKQUEUE_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#include <ClassiX/typedef.h>
+
+/* 工作项函数类型 */
+typedef void (*WORK_FUNC)(void *arg);
+
+/* 工作项：由中断处理程序或定时器提交，在工作线程中以开中断执行 */
+typedef struct WORK {
+	WORK_FUNC func;			/* 执行的函数 */
+	void *arg;				/* 传递给函数的参数 */
+	struct WORK *next;		/* 队列中的后一个工作项 */
+	bool pending;			/* 是否已提交、尚未开始执行 */
+} WORK;
+
+#define WORK_INITIALIZER(func, arg)			{ (func), (arg), NULL, false }
+
+/* 工作队列统计 */
+typedef struct {
+	uint32_t queued;		/* 提交的次数 */
+	uint32_t executed;		/* 执行的次数 */
+	uint32_t coalesced;		/* 提交时尚未执行、与前一次合并的次数 */
+} WORKQUEUE_STATS;
+
+extern WORKQUEUE_STATS g_workqueue_stats;
+
+void init_workqueue(void);
+void work_init(WORK *work, WORK_FUNC func, void *arg);
+bool work_queue(WORK *work);
+bool work_cancel(WORK *work);
+bool work_busy(const WORK *work);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif
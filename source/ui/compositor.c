@@ -0,0 +1,198 @@
+/*
+	ui/compositor.c
+*/
+
+#include <ClassiX/compositor.h>
+#include <ClassiX/cpu.h>
+#include <ClassiX/debug.h>
+#include <ClassiX/io.h>
+#include <ClassiX/layer.h>
+#include <ClassiX/pit.h>
+#include <ClassiX/sync.h>
+#include <ClassiX/task.h>
+#include <ClassiX/typedef.h>
+#include <ClassiX/window.h>
+
+COMPOSITOR_STATS g_compositor_stats;				/* 合成统计 */
+
+/*
+	单生产者、单消费者的无锁环形队列：输入任务只写 tail，合成任务只写 head，
+	两者均只增不减，取模后定位槽位。发布与消费分别以 release / acquire 序保证槽位内容先于下标可见。
+*/
+static COMPOSE_REQUEST queue[COMPOSITOR_QUEUE_SIZE];
+static volatile uint32_t queue_head = 0;			/* 下一个待处理的请求 */
+static volatile uint32_t queue_tail = 0;			/* 下一个空闲槽位 */
+static WAIT_QUEUE compositor_wait = WAIT_QUEUE_INITIALIZER;	/* 等待请求的合成任务 */
+static TASK *compositor = NULL;						/* 合成任务 */
+
+/* 一帧内待执行的图层移动，同一图层只保留最后的位置 */
+typedef struct {
+	LAYER *layer;
+	int32_t x, y;
+} PENDING_MOVE;
+
+/*
+	取出全部待处理的请求并合成一帧：激活按顺序执行，移动按图层合并后各执行一次。
+	整帧持有图层管理器的锁，窗口销毁时撤销的请求因此不会在读出后才被撤销；
+	执行前再确认图层仍在使用、仍属于请求中的窗口，跳过在撤销之后才发布的过期请求。
+*/
+static void compositor_frame(void)
+{
+	PENDING_MOVE moves[COMPOSITOR_MAX_MOVES];
+	uint32_t count = 0;
+	uint64_t oldest = 0;
+
+	layer_lock();
+	uint32_t head = queue_head;
+	uint32_t tail = __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		COMPOSE_REQUEST *req = &queue[head % COMPOSITOR_QUEUE_SIZE];
+		if (!oldest)
+			oldest = req->tsc;
+		g_compositor_stats.requests++;
+
+		LAYER *layer = req->layer;
+		if (!layer || layer->flags != LAYER_USED)
+			continue;
+
+		if (req->op == COMPOSE_ACTIVATE) {
+			if (layer->window == req->window)
+				window_activate(req->window);
+			continue;
+		}
+
+		uint32_t i = 0;
+		while (i < count && moves[i].layer != layer)
+			i++;
+		if (i < count) {
+			g_compositor_stats.coalesced++;
+		} else if (count == COMPOSITOR_MAX_MOVES) {
+			/* 不同图层过多，先执行最早记录的一个 */
+			layer_move(moves[0].layer, moves[0].x, moves[0].y);
+			i = 0;
+			moves[0].layer = layer;
+		} else {
+			moves[count++].layer = layer;
+		}
+		moves[i].x = req->x;
+		moves[i].y = req->y;
+	}
+
+	/* 槽位已全部读出，归还给输入任务 */
+	__atomic_store_n(&queue_head, head, __ATOMIC_RELEASE);
+
+	for (uint32_t i = 0; i < count; i++)
+		layer_move(moves[i].layer, moves[i].x, moves[i].y);
+	layer_unlock();
+
+	g_compositor_stats.frames++;
+	if (oldest && tsc_khz) {
+		uint64_t cycles = rdtsc() - oldest;
+		uint32_t latency = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t) cycles;
+		g_compositor_stats.latency_total += latency;
+		if (latency > g_compositor_stats.latency_max)
+			g_compositor_stats.latency_max = latency;
+	}
+}
+
+/* 合成任务：队列为空时休眠，被唤醒后把积压的请求合成为一帧 */
+static void compositor_entry(void *arg)
+{
+	for (;;) {
+		cli();
+		while (queue_head == __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE))
+			wait_queue_sleep(&compositor_wait, NULL);
+		sti();
+
+		compositor_frame();
+	}
+}
+
+/* 发布一个请求；队列已满时休眠等待合成任务腾出槽位。只能由输入任务调用 */
+static void compositor_post(COMPOSE_REQUEST *req)
+{
+	req->tsc = tsc_khz ? rdtsc() : 0;
+
+	uint32_t tail = queue_tail;
+	while (tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE) >= COMPOSITOR_QUEUE_SIZE) {
+		g_compositor_stats.stalls++;
+		task_sleep_ms(1);
+	}
+
+	queue[tail % COMPOSITOR_QUEUE_SIZE] = *req;
+	__atomic_store_n(&queue_tail, tail + 1, __ATOMIC_RELEASE);
+
+	/* 合成任务关中断检查队列后才进入等待队列，此时等待队列为空说明它尚未检查，必能看到新请求 */
+	if (compositor_wait.head)
+		wait_queue_wake_one(&compositor_wait);
+}
+
+/*
+	@brief 初始化合成任务。
+	@return 成功返回 true，失败返回 false
+	@note 须在 init_pit 之后、图层管理初始化完毕后由输入任务调用。合成任务每 10 ms 预留 4 ms 处理器时间，
+		  预算耗尽后以低于输入任务的 PRIORITY_NORMAL 运行。
+*/
+bool init_compositor(void)
+{
+	compositor = kthread_create(compositor_entry, NULL, PRIORITY_NORMAL);
+	if (!compositor) {
+		debug("COMPOSITOR: Failed to create compositor task.\n");
+		return false;
+	}
+	task_set_realtime(compositor, 10, 4000);
+
+	debug("COMPOSITOR: Initialized.\n");
+	return true;
+}
+
+/*
+	@brief 请求移动图层。
+	@param layer 图层
+	@param x 目标 X 坐标
+	@param y 目标 Y 坐标
+	@note 只能由输入任务调用。同一帧内对同一图层的多次移动只执行最后一次。未初始化合成任务时直接移动。
+*/
+void compositor_move(LAYER *layer, int32_t x, int32_t y)
+{
+	if (!compositor) {
+		layer_move(layer, x, y);
+		return;
+	}
+
+	COMPOSE_REQUEST req = { .op = COMPOSE_MOVE, .layer = layer, .x = x, .y = y };
+	compositor_post(&req);
+}
+
+/*
+	@brief 请求激活窗口。
+	@param window 窗口
+	@note 只能由输入任务调用。按请求的先后顺序执行。未初始化合成任务时直接激活。
+*/
+void compositor_activate(WINDOW *window)
+{
+	if (!compositor) {
+		window_activate(window);
+		return;
+	}
+
+	COMPOSE_REQUEST req = { .op = COMPOSE_ACTIVATE, .layer = window->layer, .window = window };
+	if (req.layer)
+		compositor_post(&req);
+}
+
+/*
+	@brief 撤销以图层为目标、尚未处理的请求。
+	@param layer 图层
+	@note 须持有图层管理器的锁。window_destroy 在释放图层前调用，此后队列中不再有指向该窗口的请求。
+*/
+void compositor_cancel(LAYER *layer)
+{
+	/* 合成任务只在持锁时读取槽位、前移 head；输入任务只写 tail 及其后的槽位 */
+	uint32_t tail = __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE);
+	for (uint32_t head = queue_head; head != tail; head++) {
+		COMPOSE_REQUEST *req = &queue[head % COMPOSITOR_QUEUE_SIZE];
+		if (req->layer == layer)
+			req->layer = NULL;
+	}
+}
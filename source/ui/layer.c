@@ -7,12 +7,42 @@
 #include <ClassiX/layer.h>
 #include <ClassiX/memory.h>
 #include <ClassiX/palette.h>
+#include <ClassiX/sync.h>
+#include <ClassiX/task.h>
 #include <ClassiX/typedef.h>
 
 #include <string.h>
 
 LAYER_MANAGER g_lm;
 
+static MUTEX layer_mutex = MUTEX_INITIALIZER;	/* 保护 g_lm 及各图层的位置与 Z 序 */
+static uint32_t layer_depth = 0;				/* 持有者嵌套获取的次数 */
+
+/*
+	@brief 获取图层管理器的锁，持有者可嵌套获取。
+	@note 须在任务上下文中调用。由多个图层操作组成、须整体完成的过程（如窗口激活）应在外层持有此锁。
+*/
+void layer_lock(void)
+{
+	/* 只有持有者自己会成为 owner，不关中断读取也不会误判 */
+	if (layer_mutex.owner == task_get_current()) {
+		layer_depth++;
+		return;
+	}
+
+	mutex_lock(&layer_mutex);
+	layer_depth = 1;
+}
+
+/*
+	@brief 释放图层管理器的锁。
+*/
+void layer_unlock(void)
+{
+	if (--layer_depth == 0)
+		mutex_unlock(&layer_mutex);
+}
+
 /*
 	@brief 初始化图层管理器。
 	@param fb 帧缓冲地址。
@@ -54,11 +84,13 @@ LAYER *layer_alloc(uint16_t width, uint16_t height, bool allow_inv)
 {
 	LAYER *layer;
 
+	layer_lock();
 	for (int32_t i = 0; i < MAX_LAYERS; i++) {
 		if (g_lm.layers0[i].flags == LAYER_FREE) {
 			layer = &g_lm.layers0[i];
 			layer->buf = kmalloc(width * height * sizeof(uint32_t));
 			if (!layer->buf) {
+				layer_unlock();
 				debug("LAYER: Failed to allocate memory for new layer.\n");
 				return NULL;
 			}
@@ -69,11 +101,13 @@ LAYER *layer_alloc(uint16_t width, uint16_t height, bool allow_inv)
 			layer->z = -1; /* 隐藏 */
 			layer->allow_inv = allow_inv;
 			layer->window = NULL;
+			layer_unlock();
 
 			debug("LAYER: Layer created at %p, size %dx%d.\n", layer, width, height);
 			return layer;
 		}
 	}
+	layer_unlock();
 
 	debug("LAYER: Failed to allocate free layer.\n");
 	return NULL;
@@ -203,8 +237,12 @@ static void layer_refreshsub(int32_t vx0, int32_t vy0, int32_t vx1, int32_t vy1,
 */
 void layer_set_z(LAYER *layer, int32_t z1)
 {
+	layer_lock();
 	int32_t z0 = layer->z;
-	if (z0 == z1) return;
+	if (z0 == z1) {
+		layer_unlock();
+		return;
+	}
 
 	/* 对超出范围的值进行修正 */
 	if (z1 > g_lm.top + 1) z1 = g_lm.top + 1;
@@ -252,6 +290,7 @@ void layer_set_z(LAYER *layer, int32_t z1)
 		layer_refreshmap(layer->x, layer->y, layer->x + layer->width, layer->y + layer->height, z1);
 		layer_refreshsub(layer->x, layer->y, layer->x + layer->width, layer->y + layer->height, z1, z1);
 	}
+	layer_unlock();
 }
 
 /*
@@ -264,8 +303,10 @@ void layer_set_z(LAYER *layer, int32_t z1)
 */
 void layer_refresh(const LAYER *layer, int32_t x0, int32_t y0, int32_t x1, int32_t y1)
 {
+	layer_lock();
 	if (layer->z >= 0)
 		layer_refreshsub(layer->x + x0, layer->y + y0, layer->x + x1, layer->y + y1, layer->z, layer->z);
+	layer_unlock();
 }
 
 /*
@@ -276,6 +317,7 @@ void layer_refresh(const LAYER *layer, int32_t x0, int32_t y0, int32_t x1, int32
 */
 void layer_move(LAYER *layer, int32_t x, int32_t y)
 {
+	layer_lock();
 	int32_t x0 = layer->x, y0 = layer->y;
 	layer->x = x;
 	layer->y = y;
@@ -286,6 +328,7 @@ void layer_move(LAYER *layer, int32_t x, int32_t y)
 		layer_refreshsub(x0, y0, x0 + layer->width, y0 + layer->height, 0, layer->z - 1);
 		layer_refreshsub(x, y, x + layer->width, y + layer->height, layer->z, layer->z);
 	}
+	layer_unlock();
 }
 
 /*
@@ -294,10 +337,12 @@ void layer_move(LAYER *layer, int32_t x, int32_t y)
 */
 void layer_free(LAYER *layer)
 {
+	layer_lock();
 	if (layer->z >= 0)
 		layer_set_z(layer, -1);
 
 	layer->flags = LAYER_FREE;
 	kfree(layer->buf);
+	layer_unlock();
 	return;
 }
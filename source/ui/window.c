@@ -3,6 +3,7 @@
 */
 
 #include <ClassiX/assets.h>
+#include <ClassiX/compositor.h>
 #include <ClassiX/debug.h>
 #include <ClassiX/fifo.h>
 #include <ClassiX/font.h>
@@ -62,9 +63,10 @@ void cursor_set(CURSOR type)
 	if (csr->magic != CSR_MAGIC)
 		return;
 
+	layer_lock();
 	cursor_current = csr;
-
 	memcpy(cursor_layer->buf, (uint8_t *) (cursor_current + 1), cursor_current->width * cursor_current->height * sizeof(COLOR));
+	layer_unlock();
 }
 
 #define DEFAULT_FONT_WIDTH					(8)		/* 默认字体宽度 */
@@ -167,9 +169,12 @@ int32_t window_create(WINDOW *window, int16_t x, int16_t y, uint16_t width, uint
 	window->title = title;
 
 	/* 创建图层 */
+	layer_lock();
 	window->layer = layer_alloc(window->width, window->height, false);
-	if (!window->layer)
+	if (!window->layer) {
+		layer_unlock();
 		return WD_NO_MEMORY; /* 内存不足 */
+	}
 
 	window->layer->window = window;
 
@@ -206,6 +211,7 @@ int32_t window_create(WINDOW *window, int16_t x, int16_t y, uint16_t width, uint
 	/* 绘制窗口 */
 	window_paint(window);
 	layer_refresh(window->layer, 0, 0, window->width - 1, window->height - 1);
+	layer_unlock();
 
 	/* 发送窗口绘制事件 */
 	if (task) {
@@ -222,6 +228,8 @@ int32_t window_create(WINDOW *window, int16_t x, int16_t y, uint16_t width, uint
 */
 void window_paint(WINDOW *window)
 {
+	layer_lock();
+
 	/* 绘制窗口背景 */
 	window_fill_rectangle(window, 0, 0, window->width, window->height, COLOR_SYSTEM_WINDOW_BACKGROUND);
 
@@ -238,6 +246,8 @@ void window_paint(WINDOW *window)
 		/* 绘制标题栏 */
 		window_draw_titlebar(window, false);
 	}
+
+	layer_unlock();
 }
 
 /*
@@ -246,10 +256,21 @@ void window_paint(WINDOW *window)
 */
 void window_destroy(WINDOW *window)
 {
+	layer_lock();
+
+	/* 隐藏窗口并移交焦点，避免 layer_focused 指向已释放的图层 */
+	window_inactivate(window);
+	if (layer_focused == window->layer)
+		layer_focused = NULL;
+
+	/* 撤销合成任务中尚未处理的请求，避免其稍后访问已释放的窗口 */
+	compositor_cancel(window->layer);
+
 	/* 释放图层 */
 	layer_free(window->layer);
 	window->layer = NULL;
 
+	layer_unlock();
 	return;
 }
 
@@ -260,8 +281,11 @@ void window_destroy(WINDOW *window)
 */
 void window_focus(LAYER **focused_layer, LAYER *new_layer)
 {
-	if (*focused_layer == new_layer)
+	layer_lock();
+	if (*focused_layer == new_layer) {
+		layer_unlock();
 		return; /* 已经是焦点 */
+	}
 
 	if (*focused_layer) {
 		/* 失去焦点，重绘标题栏 */
@@ -302,6 +326,7 @@ void window_focus(LAYER **focused_layer, LAYER *new_layer)
 			fifo_push_event(&new_window->task->fifo, &event);
 		}
 	}
+	layer_unlock();
 }
 
 /*
@@ -312,9 +337,13 @@ void window_activate(WINDOW *window)
 {
 	if (!window)
 		return;
+
+	layer_lock();
 	LAYER *layer = window->layer;
-	if (!layer)
+	if (!layer) {
+		layer_unlock();
 		return;
+	}
 
 	int32_t target_z;
 	if (window->style & WINSTYLE_BOTTOMMOST) {
@@ -339,6 +368,7 @@ void window_activate(WINDOW *window)
 	layer_set_z(layer, target_z);
 	layer_set_z(cursor_layer, g_lm.top);
 	window_focus(&layer_focused, layer);
+	layer_unlock();
 }
 
 /*
@@ -349,9 +379,13 @@ void window_inactivate(WINDOW *window)
 {
 	if (!window)
 		return;
+
+	layer_lock();
 	LAYER *layer = window->layer;
-	if (!layer)
+	if (!layer) {
+		layer_unlock();
 		return;
+	}
 
 	if (layer->z >= 0) {
 		/* 隐藏目标图层 */
@@ -370,6 +404,7 @@ void window_inactivate(WINDOW *window)
 			window_focus(&layer_focused, new_focus);
 		}
 	}
+	layer_unlock();
 }
 
 /*
@@ -382,13 +417,15 @@ void window_set_position(WINDOW *window, int16_t x, int16_t y)
 {
 	if (!window)
 		return;
-	LAYER *layer = window->layer;
-	if (!layer)
-		return;
 
-	window->x = x;
-	window->y = y;
-	layer_move(layer, x, y);
+	layer_lock();
+	LAYER *layer = window->layer;
+	if (layer) {
+		window->x = x;
+		window->y = y;
+		layer_move(layer, x, y);
+	}
+	layer_unlock();
 }
 
 /*
@@ -4,7 +4,7 @@
 
 #include <ClassiX/fifo.h>
 #include <ClassiX/io.h>
-#include <ClassiX/task.h>
+#include <ClassiX/sync.h>
 #include <ClassiX/typedef.h>
 #include <ClassiX/window.h>
 
@@ -13,16 +13,25 @@
 	@param fifo FIFO 结构体指针
 	@param size FIFO 缓冲区大小
 	@param buf FIFO 缓冲区指针
-	@param task 有数据写入时需要唤醒的任务
 */
-void fifo_init(FIFO *fifo, size_t size, uint32_t *buf, TASK *task)
+void fifo_init(FIFO *fifo, size_t size, uint32_t *buf)
 {
 	fifo->buf = buf;
 	fifo->size = size;
 	fifo->free = size;		/* 空 */
 	fifo->idx_read = 0;		/* 读取位置 */
 	fifo->idx_write = 0;	/* 写入位置 */
-	fifo->task = task;		/* 有数据写入时需要唤醒的任务 */
+	wait_queue_init(&fifo->waiters);	/* 等待数据的任务 */
+}
+
+/* 写入一个数据，不唤醒等待的任务；须在关中断时调用 */
+static inline void fifo_put(FIFO *fifo, uint32_t data)
+{
+	fifo->buf[fifo->idx_write] = data;
+	fifo->idx_write++;
+	if ((size_t) fifo->idx_write == fifo->size)
+		fifo->idx_write = 0;
+	fifo->free--;
 }
 
 /*
@@ -30,23 +39,19 @@ void fifo_init(FIFO *fifo, size_t size, uint32_t *buf, TASK *task)
 	@param fifo FIFO 结构体指针
 	@param data 要写入的数据
 	@return 如果写入成功，返回 0；如果 FIFO 已满，返回 -1。
+	@note 唤醒全部等待数据的任务，可在中断处理程序中调用。
 */
 int32_t fifo_push(FIFO *fifo, uint32_t data)
 {
 	if (fifo->free == 0)
 		return -1; /* 无空间则溢出 */
 
+	uint32_t eflags = load_eflags();
 	cli();
-	fifo->buf[fifo->idx_write] = data;
-	fifo->idx_write++;
-	if ((size_t) fifo->idx_write == fifo->size)
-		fifo->idx_write = 0;
-	fifo->free--;
-	sti();
-
-	if (fifo->task)
-		if (fifo->task->state != TASK_RUNNING) /* 任务处于休眠状态 */
-			task_register(fifo->task, fifo->task->priority); /* 唤醒任务 */
+	fifo_put(fifo, data);
+	if (fifo->waiters.head)
+		wait_queue_wake_all(&fifo->waiters); /* 唤醒等待数据的任务 */
+	store_eflags(eflags);
 
 	return 0;
 }
@@ -62,6 +67,7 @@ uint32_t fifo_pop(FIFO *fifo)
 	if (fifo->free == fifo->size)
 		return -1; /* 缓冲区为空则溢出 */
 
+	uint32_t eflags = load_eflags();
 	cli();
 	data = fifo->buf[fifo->idx_read];
 	fifo->idx_read++;
@@ -69,7 +75,7 @@ uint32_t fifo_pop(FIFO *fifo)
 		fifo->idx_read = 0;
 
 	fifo->free++;
-	sti();
+	store_eflags(eflags);
 
 	return data;
 }
@@ -84,6 +90,21 @@ int32_t fifo_status(const FIFO *fifo)
 	return fifo->size - fifo->free;
 }
 
+/*
+	@brief 休眠等待，直至 FIFO 中至少有指定数量的数据。
+	@param fifo FIFO 结构体指针
+	@param count 需要的数据数量
+	@note 须在任务上下文中调用。检查与休眠之间关闭中断，不会错过 fifo_push 的唤醒。
+*/
+void fifo_wait(FIFO *fifo, int32_t count)
+{
+	uint32_t eflags = load_eflags();
+	cli();
+	while (fifo_status(fifo) < count)
+		wait_queue_sleep(&fifo->waiters, NULL);
+	store_eflags(eflags);
+}
+
 /*
 	@brief 向 FIFO 中写入事件。
 	@param fifo FIFO 结构体指针
@@ -95,11 +116,15 @@ int32_t fifo_push_event(FIFO *fifo, const EVENT *event)
 	if (fifo->free < 3)
 		return -1;
 
+	/* 三个字全部写入后才唤醒，等待的任务不会读到不完整的事件 */
+	uint32_t eflags = load_eflags();
 	cli();
-	fifo_push(fifo, (uint32_t) event->window);
-	fifo_push(fifo, event->id);
-	fifo_push(fifo, event->param);
-	sti();
+	fifo_put(fifo, (uint32_t) event->window);
+	fifo_put(fifo, event->id);
+	fifo_put(fifo, event->param);
+	if (fifo->waiters.head)
+		wait_queue_wake_all(&fifo->waiters);
+	store_eflags(eflags);
 	return 0;
 }
 
@@ -114,10 +139,11 @@ int32_t fifo_pop_event(FIFO *fifo, EVENT *event)
 	if (fifo_status(fifo) < 3)
 		return -1;
 
+	uint32_t eflags = load_eflags();
 	cli();
 	event->window = (WINDOW *) fifo_pop(fifo);
 	event->id = fifo_pop(fifo);
 	event->param = fifo_pop(fifo);
-	sti();
+	store_eflags(eflags);
 	return 0;
 }
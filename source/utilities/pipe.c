@@ -3,9 +3,20 @@
 */
 
 #include <ClassiX/pipe.h>
-#include <ClassiX/task.h>
+#include <ClassiX/spinlock.h>
+#include <ClassiX/sync.h>
 #include <ClassiX/typedef.h>
 
+/* 唤醒等待队列中的任务；被唤醒的任务可能立即抢占，故唤醒期间暂时释放管道锁（中断保持关闭） */
+static void pipe_wake(PIPE *pipe, WAIT_QUEUE *wq)
+{
+	if (!wq->head)
+		return;
+	spinlock_release(&pipe->lock);
+	wait_queue_wake_all(wq);
+	spinlock_acquire(&pipe->lock);
+}
+
 /*
 	@brief 初始化管道。
 	@param pipe 管道对象
@@ -19,8 +30,8 @@ void pipe_init(PIPE *pipe, uint8_t *buf, size_t size)
 	pipe->free = size;
 	pipe->pos_read = 0;
 	pipe->pos_write = 0;
-	pipe->reader = NULL;
-	pipe->writer = NULL;
+	wait_queue_init(&pipe->readers);
+	wait_queue_init(&pipe->writers);
 	spinlock_init(&pipe->lock);
 }
 
@@ -38,12 +49,8 @@ size_t pipe_read(PIPE *pipe, uint8_t *buf, size_t count)
 
 	while (count > 0) {
 		if (pipe->free == pipe->size) {
-			/* 缓冲区为空 */
-			TASK *current = task_get_current();
-			pipe->reader = current;
-			spinlock_release_irqrestore(&pipe->lock, eflags);
-			task_sleep(current);
-			eflags = spinlock_acquire_irqsave(&pipe->lock);
+			/* 缓冲区为空，释放锁后休眠，中断保持关闭，不会错过写任务的唤醒 */
+			wait_queue_sleep(&pipe->readers, &pipe->lock);
 			continue;
 		}
 
@@ -58,10 +65,7 @@ size_t pipe_read(PIPE *pipe, uint8_t *buf, size_t count)
 		count -= to_read;
 
 		/* 唤醒等待写入的任务 */
-		if (pipe->writer && pipe->free > 0) {
-			task_register(pipe->writer, PRIORITY_NORMAL);
-			pipe->writer = NULL;
-		}
+		pipe_wake(pipe, &pipe->writers);
 	}
 
 	spinlock_release_irqrestore(&pipe->lock, eflags);
@@ -82,12 +86,8 @@ size_t pipe_write(PIPE *pipe, const uint8_t *buf, size_t count)
 
 	while (count > 0) {
 		if (pipe->free == 0) {
-			/* 缓冲区已满 */
-			TASK *current = task_get_current();
-			pipe->writer = current;
-			spinlock_release_irqrestore(&pipe->lock, eflags);
-			task_sleep(current);
-			eflags = spinlock_acquire_irqsave(&pipe->lock);
+			/* 缓冲区已满，释放锁后休眠 */
+			wait_queue_sleep(&pipe->writers, &pipe->lock);
 			continue;
 		}
 
@@ -102,10 +102,7 @@ size_t pipe_write(PIPE *pipe, const uint8_t *buf, size_t count)
 		count -= to_write;
 
 		/* 唤醒等待读取的任务 */
-		if (pipe->reader && pipe->free < pipe->size) {
-			task_register(pipe->reader, PRIORITY_NORMAL);
-			pipe->reader = NULL;
-		}
+		pipe_wake(pipe, &pipe->readers);
 	}
 
 	spinlock_release_irqrestore(&pipe->lock, eflags);
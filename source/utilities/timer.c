@@ -6,27 +6,136 @@
 #include <ClassiX/io.h>
 #include <ClassiX/memory.h>
 #include <ClassiX/pit.h>
+#include <ClassiX/slab.h>
 #include <ClassiX/spinlock.h>
 #include <ClassiX/timer.h>
 #include <ClassiX/typedef.h>
+#include <ClassiX/workqueue.h>
 
-static TIMER *timer_head = NULL;						/* 定时器链表的头指针 */
-static spinlock_t timer_lock = SPINLOCK_INITIALIZER;	/* 自旋锁，保护定时器链表 */
+#define WHEEL_MASK							(TIMER_WHEEL_SIZE - 1)
+#define WHEEL_SHIFT(level)					((level) * TIMER_WHEEL_BITS)
+#define WHEEL_MAX_DELTA						((1ull << WHEEL_SHIFT(TIMER_WHEEL_LEVELS)) - 1)	/* 时间轮能直接容纳的最远到期时间 */
+
+/*
+	分级时间轮：第 l 级的每个槽覆盖 2^(6l) 个滴答，到期时间距 wheel_now 越远的定时器放在越高的级别。
+	每个滴答只处理第 0 级的一个槽；第 0 级转完一圈时，将上一级的下一个槽中的定时器按剩余时间重新放入低级，依此类推。
+	激活的定时器位于时间轮的槽中，其余定时器位于未激活链表中，二者均为双向链表，启动、停止与删除均为 O(1)。
+*/
+static TIMER *wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];	/* 各级时间轮的槽 */
+static uint64_t wheel_bitmap[TIMER_WHEEL_LEVELS];			/* 各级非空槽位图 */
+static uint64_t wheel_now = 0;								/* 时间轮已处理到的滴答 */
+static TIMER *idle_timers = NULL;							/* 未激活与已过期定时器的链表 */
+static TIMER *running_timer = NULL;							/* 正在执行回调的定时器 */
+static uint32_t timer_count = 0;							/* 定时器总数 */
+static uint32_t active_count = 0;							/* 激活的定时器数 */
+static spinlock_t timer_lock = SPINLOCK_INITIALIZER;		/* 自旋锁，保护时间轮与定时器链表 */
+static KMEM_CACHE *timer_cache = NULL;						/* 定时器对象缓存 */
+
+static void timer_cleanup_work(void *arg);
+static WORK cleanup_work = WORK_INITIALIZER(timer_cleanup_work, NULL);	/* 在工作线程中执行的定期清理 */
+
+/* 将定时器插入链表头 */
+static inline void list_insert(TIMER **list, TIMER *timer)
+{
+	timer->list = list;
+	timer->prev = NULL;
+	timer->next = *list;
+	if (*list)
+		(*list)->prev = timer;
+	*list = timer;
+}
+
+/* 将定时器移出所在链表；移出时间轮的槽时同步更新位图 */
+static inline void list_remove(TIMER *timer)
+{
+	if (timer->prev)
+		timer->prev->next = timer->next;
+	else
+		*timer->list = timer->next;
+	if (timer->next)
+		timer->next->prev = timer->prev;
+
+	if (timer->list != &idle_timers && !*timer->list) {
+		uint32_t index = timer->list - &wheel[0][0];
+		wheel_bitmap[index / TIMER_WHEEL_SIZE] &= ~(1ull << (index % TIMER_WHEEL_SIZE));
+	}
+	timer->list = NULL;
+}
+
+/*
+	按到期时间将定时器放入时间轮，早于 earliest 到期的定时器在 earliest 处理。
+	级联发生在处理当前滴答的槽之前，此时 earliest 为 wheel_now；其余情况下当前滴答已处理完毕，earliest 为 wheel_now + 1。
+*/
+static void wheel_insert(TIMER *timer, uint64_t earliest)
+{
+	uint64_t expire = timer->expire_tick > earliest ? timer->expire_tick : earliest;
+	uint64_t delta = expire - wheel_now;
+	if (delta > WHEEL_MAX_DELTA) {
+		/* 超出时间轮范围的定时器先放在最高级，级联时再按实际到期时间放置 */
+		delta = WHEEL_MAX_DELTA;
+		expire = wheel_now + delta;
+	}
+
+	uint32_t level = 0;
+	while (delta >> WHEEL_SHIFT(level + 1))
+		level++;
+
+	uint32_t slot = (expire >> WHEEL_SHIFT(level)) & WHEEL_MASK;
+	list_insert(&wheel[level][slot], timer);
+	wheel_bitmap[level] |= 1ull << slot;
+}
+
+/* 将第 level 级的一个槽中的定时器重新放入时间轮，返回该槽的序号 */
+static uint32_t wheel_cascade(uint32_t level)
+{
+	uint32_t slot = (wheel_now >> WHEEL_SHIFT(level)) & WHEEL_MASK;
+	TIMER *timer = wheel[level][slot];
+	wheel[level][slot] = NULL;
+	wheel_bitmap[level] &= ~(1ull << slot);
+
+	while (timer) {
+		TIMER *next = timer->next;
+		wheel_insert(timer, wheel_now);
+		timer = next;
+	}
+	return slot;
+}
+
+/* 位图中从第 start 位起（循环）第一个置位的位相对 start 的距离；位图为空时返回 TIMER_WHEEL_SIZE */
+static inline uint32_t bitmap_distance(uint64_t bitmap, uint32_t start)
+{
+	if (!bitmap)
+		return TIMER_WHEEL_SIZE;
+	uint64_t rotated = start ? (bitmap >> start) | (bitmap << (TIMER_WHEEL_SIZE - start)) : bitmap;
+	uint32_t low = (uint32_t) rotated;
+	return low ? __builtin_ctz(low) : 32 + __builtin_ctz((uint32_t) (rotated >> 32));	/* 避免依赖 libgcc 的 __ctzdi2 */
+}
 
 /*
 	@brief 创建一个新的定时器。
 	@param callback 定时器到期时调用的回调函数
 	@param arg 传递给回调函数的参数
+	@param flags 定时器标志，TIMER_FLAG_WORKER 表示回调在工作线程中执行，TIMER_FLAG_AUTO_DELETE 表示到期后自动回收
 	@return 新定时器，失败返回 NULL
+	@note 默认回调在 PIT 中断中以关中断执行，须短小且不可休眠；耗时的回调应使用 TIMER_FLAG_WORKER。
+		  未带 TIMER_FLAG_AUTO_DELETE 的定时器由创建者负责删除。
 */
-TIMER *timer_create(TIMER_CALLBACK callback, void *arg)
+TIMER *timer_create(TIMER_CALLBACK callback, void *arg, uint32_t flags)
 {
 	if (callback == NULL) {
 		debug("TIMER: Invalid timer parameters.\n");
 		return 0; /* 无效参数 */
 	}
 
-	TIMER *new_timer = (TIMER *) kmalloc(sizeof(TIMER));
+	if (!timer_cache) {
+		/* 首次使用时创建对象缓存 */
+		uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
+		if (!timer_cache)
+			timer_cache = kmem_cache_create("timer", sizeof(TIMER), 0);
+		spinlock_release_irqrestore(&timer_lock, eflags);
+	}
+
+	TIMER *new_timer = (TIMER *) kmem_cache_alloc(timer_cache);
 	if (!new_timer) {
 		debug("TIMER: Failed to allocate memory for new timer.\n");
 		return NULL; /* 内存分配失败 */
@@ -38,18 +147,10 @@ TIMER *timer_create(TIMER_CALLBACK callback, void *arg)
 	new_timer->callback = callback;
 	new_timer->arg = arg;
 	new_timer->state = TIMER_INACTIVE;
-	new_timer->next = NULL;
-
-	/* 将新定时器插入链表 */
-	if (!timer_head) {
-		timer_head = new_timer;
-	} else {
-		TIMER *current = timer_head;
-		while (current->next) {
-			current = current->next;
-		}
-		current->next = new_timer;
-	}
+	new_timer->flags = flags;
+	work_init(&new_timer->work, callback, arg);
+	list_insert(&idle_timers, new_timer);
+	timer_count++;
 
 	spinlock_release_irqrestore(&timer_lock, eflags);
 	debug("TIMER: Created timer %p.\n", new_timer);
@@ -67,29 +168,24 @@ int32_t timer_start(TIMER *timer, uint64_t interval, int32_t repetition)
 {
 	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
 
-	TIMER *current = timer_head;
-	while (current) {
-		if (current == timer) {
-			if (current->state == TIMER_ACTIVE) {
-				debug("TIMER: Timer %p is already active.\n", timer);
-				spinlock_release_irqrestore(&timer_lock, eflags);
-				return -1; /* 定时器已激活 */
-			}
-			current->interval = interval;
-			current->repetition = repetition;
-			current->expire_tick = get_system_ticks() + interval;
-			current->state = TIMER_ACTIVE;
-			spinlock_release_irqrestore(&timer_lock, eflags);
-			debug("TIMER: Started timer %p, interval %llu ticks, expires at tick %llu, repeats %d times.\n",
-				current, current->interval, current->expire_tick, repetition);
-			return 0; /* 成功启动定时器 */
-		}
-		current = current->next;
+	if (timer->state == TIMER_ACTIVE) {
+		debug("TIMER: Timer %p is already active.\n", timer);
+		spinlock_release_irqrestore(&timer_lock, eflags);
+		return -1; /* 定时器已激活 */
 	}
 
+	timer->interval = interval;
+	timer->repetition = repetition;
+	timer->expire_tick = get_system_ticks() + interval;
+	timer->state = TIMER_ACTIVE;
+	list_remove(timer);
+	wheel_insert(timer, wheel_now + 1);
+	active_count++;
+
 	spinlock_release_irqrestore(&timer_lock, eflags);
-	debug("TIMER: Timer %p not found.\n", timer);
-	return -1; /* 未找到定时器 */
+	debug("TIMER: Started timer %p, interval %llu ticks, expires at tick %llu, repeats %d times.\n",
+		timer, timer->interval, timer->expire_tick, repetition);
+	return 0; /* 成功启动定时器 */
 }
 
 /*
@@ -101,94 +197,108 @@ int32_t timer_stop(TIMER *timer)
 {
 	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
 
-	TIMER *current = timer_head;
-	while (current) {
-		if (current == timer) {
-			if (current->state != TIMER_ACTIVE) {
-				debug("TIMER: Timer %p is not active.\n", timer);
-				spinlock_release_irqrestore(&timer_lock, eflags);
-				return -1; /* 定时器未激活 */
-			}
-			current->state = TIMER_INACTIVE;
-			spinlock_release_irqrestore(&timer_lock, eflags);
-			debug("TIMER: Stopped timer %p.\n", timer);
-			return 0; /* 成功停止定时器 */
-		}
-		current = current->next;
+	if (timer->state != TIMER_ACTIVE) {
+		debug("TIMER: Timer %p is not active.\n", timer);
+		spinlock_release_irqrestore(&timer_lock, eflags);
+		return -1; /* 定时器未激活 */
 	}
 
+	timer->state = TIMER_INACTIVE;
+	list_remove(timer);
+	list_insert(&idle_timers, timer);
+	active_count--;
+
 	spinlock_release_irqrestore(&timer_lock, eflags);
-	debug("TIMER: Timer %p not found.\n", timer);
-	return -1; /* 未找到定时器 */
+	debug("TIMER: Stopped timer %p.\n", timer);
+	return 0; /* 成功停止定时器 */
 }
 
 /*
 	@brief 删除指定定时器。
 	@param timer 定时器
 	@return 成功返回 0，失败返回 -1
+	@note 可在定时器自身的回调中调用。尚未执行的工作线程回调随之取消，已开始执行的回调不受影响。
 */
 int32_t timer_delete(TIMER *timer)
 {
 	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
 
-	TIMER *current = timer_head;
-	TIMER *prev = NULL;
-	while (current) {
-		if (current == timer) {
-			if (prev)
-				prev->next = current->next;
-			else
-				timer_head = current->next;
-			kfree(current);
-			spinlock_release_irqrestore(&timer_lock, eflags);
-			debug("TIMER: Deleted timer %p.\n", timer);
-			return 0; /* 成功删除定时器 */
-		}
-		prev = current;
-		current = current->next;
+	if (!timer->list) {
+		spinlock_release_irqrestore(&timer_lock, eflags);
+		debug("TIMER: Timer %p not found.\n", timer);
+		return -1; /* 未找到定时器 */
 	}
 
+	if (timer->state == TIMER_ACTIVE)
+		active_count--;
+	if (timer->flags & TIMER_FLAG_WORKER)
+		work_cancel(&timer->work);
+	list_remove(timer);
+	timer_count--;
+	if (timer == running_timer)
+		running_timer = NULL; /* 通知 timer_process 不再访问该定时器 */
+	kmem_cache_free(timer_cache, timer);
+
 	spinlock_release_irqrestore(&timer_lock, eflags);
-	debug("TIMER: Timer %p not found.\n", timer);
-	return -1; /* 未找到定时器 */
+	debug("TIMER: Deleted timer %p.\n", timer);
+	return 0; /* 成功删除定时器 */
 }
 
 /*
 	@brief 处理定时器过程。
+	@note 由 PIT 中断调用，逐个处理自上次调用以来经过的滴答，每个滴答的开销只与其间到期的定时器数量有关。
+		  此路径不输出调试信息；定期清理提交到工作线程执行。
 */
 void timer_process(void)
 {
 	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
 
 	uint64_t current_tick = get_system_ticks();
-	TIMER *current = timer_head;
-	while (current) {
-		if (current->state == TIMER_ACTIVE && current->expire_tick <= current_tick) {
+	while (wheel_now < current_tick) {
+		wheel_now++;
+
+		/* 第 0 级转完一圈时，自低向高逐级级联 */
+		for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++)
+			if ((wheel_now & ((1ull << WHEEL_SHIFT(level)) - 1)) || wheel_cascade(level))
+				break;
+
+		TIMER **slot = &wheel[0][wheel_now & WHEEL_MASK];
+		TIMER *current;
+		while ((current = *slot) != NULL) {
 			/* 定时器到期，调用回调函数 */
+			list_remove(current);
+			list_insert(&idle_timers, current);
 			current->state = TIMER_EXPIRED;
-			debug("TIMER: Timer %p expired at tick %llu, invoking callback.\n", current, current_tick);
-
-			/* 执行回调：暂时释放锁，允许其他操作 */
-			TIMER_CALLBACK callback = current->callback;
-			void *arg = current->arg;
-			spinlock_release_irqrestore(&timer_lock, eflags);	/* 释放锁，恢复之前的中断状态 */
-			if (callback)
-				callback(arg);
-			eflags = spinlock_acquire_irqsave(&timer_lock);		/* 重新获取锁，保存新的中断状态 */
-
-			/* 处理重复定时器 */
-			if (current->state == TIMER_EXPIRED) {
-				if (current->repetition < 0 || current->repetition-- > 0) {
-					current->expire_tick = current_tick + current->interval;
-					current->state = TIMER_ACTIVE;
-					debug("TIMER: Reactivated periodic timer %p to expire at tick %llu.\n", current, current->expire_tick);
-				}else {
-					current->state = TIMER_INACTIVE;
-					debug("TIMER: Timer %p set to inactive.\n", current);
-				}
+			active_count--;
+
+			if (current->flags & TIMER_FLAG_WORKER) {
+				/* 提交到工作队列；上一次的回调尚未执行时与之合并 */
+				work_queue(&current->work);
+			} else {
+				/* 执行回调：暂时释放锁，允许其他操作 */
+				TIMER_CALLBACK callback = current->callback;
+				void *arg = current->arg;
+				running_timer = current;
+				spinlock_release_irqrestore(&timer_lock, eflags);	/* 释放锁，恢复之前的中断状态 */
+				if (callback)
+					callback(arg);
+				eflags = spinlock_acquire_irqsave(&timer_lock);		/* 重新获取锁，保存新的中断状态 */
+
+				/* 回调中删除了定时器自身 */
+				if (!running_timer)
+					continue;
+				running_timer = NULL;
+			}
+
+			/* 处理重复定时器；不再重复的定时器保持 TIMER_EXPIRED，带 TIMER_FLAG_AUTO_DELETE 的由 timer_cleanup 回收 */
+			if (current->state == TIMER_EXPIRED && (current->repetition < 0 || current->repetition-- > 0)) {
+				current->expire_tick = wheel_now + current->interval;
+				current->state = TIMER_ACTIVE;
+				list_remove(current);
+				wheel_insert(current, wheel_now + 1);
+				active_count++;
 			}
 		}
-		current = current->next;
 	}
 
 	spinlock_release_irqrestore(&timer_lock, eflags);
@@ -196,44 +306,71 @@ void timer_process(void)
 	static uint64_t last_cleanup_tick = 0;
 	current_tick = get_system_ticks();
 	if (current_tick - last_cleanup_tick >= 60 * pit_frequency) {
-		/* 每 60 秒清理一次 */
-		timer_cleanup();
+		/* 每 60 秒清理一次，遍历未激活链表的开销不计入中断 */
+		work_queue(&cleanup_work);
 		last_cleanup_tick = current_tick;
 	}
 }
 
+/* 工作线程中执行的定期清理 */
+static void timer_cleanup_work(void *arg)
+{
+	(void) arg;
+	timer_cleanup();
+}
+
 /*
-	@brief 清理未激活的定时器。
+	@brief 获取最早到期的激活定时器的到期时刻。
+	@return 到期时的系统滴答数，没有激活的定时器时返回 UINT64_MAX
+	@note 高级槽中的定时器以该槽的级联时刻计，可能早于其实际到期时刻。
+*/
+uint64_t timer_next_expiry(void)
+{
+	uint64_t expiry = UINT64_MAX;
+	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
+
+	for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		/* 第 level 级的下一个槽对应的时刻，第 0 级即下一个滴答，更高级即下一次级联 */
+		uint64_t next = (wheel_now >> WHEEL_SHIFT(level)) + 1;
+		uint32_t distance = bitmap_distance(wheel_bitmap[level], next & WHEEL_MASK);
+		if (distance < TIMER_WHEEL_SIZE) {
+			uint64_t tick = (next + distance) << WHEEL_SHIFT(level);
+			if (tick < expiry)
+				expiry = tick;
+		}
+	}
+
+	spinlock_release_irqrestore(&timer_lock, eflags);
+	return expiry;
+}
+
+/*
+	@brief 回收带 TIMER_FLAG_AUTO_DELETE、已到期且不再重复的定时器。
+	@note 从未启动或已停止的定时器仍由创建者持有，不会被回收。
 */
 void timer_cleanup(void)
 {
 	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
 
 	uint32_t removed_count = 0;
-	TIMER *current = timer_head;
-	TIMER *prev = NULL;
+	TIMER *current = idle_timers;
 	while (current) {
-		if (current->state == TIMER_INACTIVE) {
-			if (prev)
-				prev->next = current->next;
-			else
-				timer_head = current->next;
-			kfree(current);
+		TIMER *next = current->next;
+		/* 工作线程回调尚未执行完毕的定时器留待下次清理 */
+		if ((current->flags & TIMER_FLAG_AUTO_DELETE) && current->state == TIMER_EXPIRED && current != running_timer &&
+			!((current->flags & TIMER_FLAG_WORKER) && work_busy(&current->work))) {
+			list_remove(current);
+			kmem_cache_free(timer_cache, current);
+			timer_count--;
 			removed_count++;
-			debug("TIMER: Cleaned up inactive timer %p.\n", current);
-			if (prev)
-				current = prev->next;
-			else
-				current = timer_head;
-		} else {
-			prev = current;
-			current = current->next;
+			debug("TIMER: Cleaned up expired timer %p.\n", current);
 		}
+		current = next;
 	}
 
 	spinlock_release_irqrestore(&timer_lock, eflags);
 	if (removed_count > 0)
-		debug("TIMER: Cleaned up %d inactive timers.\n", removed_count);
+		debug("TIMER: Cleaned up %d expired timers.\n", removed_count);
 }
 
 /*
@@ -242,17 +379,7 @@ void timer_cleanup(void)
 */
 uint32_t timer_get_count(void)
 {
-	uint32_t count = 0;
-	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
-
-	TIMER *current = timer_head;
-	while (current) {
-		count++;
-		current = current->next;
-	}
-
-	spinlock_release_irqrestore(&timer_lock, eflags);
-	return count;
+	return timer_count;
 }
 
 /*
@@ -261,16 +388,5 @@ uint32_t timer_get_count(void)
 */
 uint32_t timer_get_active_count(void)
 {
-	uint32_t count = 0;
-	uint32_t eflags = spinlock_acquire_irqsave(&timer_lock);
-
-	TIMER *current = timer_head;
-	while (current) {
-		if (current->state == TIMER_ACTIVE)
-			count++;
-		current = current->next;
-	}
-
-	spinlock_release_irqrestore(&timer_lock, eflags);
-	return count;
-}
\ No newline at end of file
+	return active_count;
+}